@@ -0,0 +1,64 @@
+#include <arena.hpp>
+
+#include <memstat.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+
+// standard chunks given back by Release() stay with the thread for its
+// next compilation, so a long running process (batch, server) stops
+// going to malloc once it is warm
+namespace {
+struct chunk_cache_t {
+  static const size_t MAX_CHUNKS = 64;
+  vector<char*> chunks;
+  ~chunk_cache_t() {
+    for (char* chunk : chunks)
+      free(chunk);
+  }
+};
+}  // namespace
+
+static thread_local chunk_cache_t chunk_cache;
+
+void* Arena::Alloc(size_t size, size_t align) {
+  uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+  if (!cur || p + size > reinterpret_cast<uintptr_t>(end)) {
+    // big objects get a chunk of their own
+    size_t chunk_size = size + align > CHUNK_SIZE ? size + align : CHUNK_SIZE;
+    char* chunk;
+    if (chunk_size == CHUNK_SIZE && !chunk_cache.chunks.empty()) {
+      chunk = chunk_cache.chunks.back();
+      chunk_cache.chunks.pop_back();
+    } else {
+      chunk = static_cast<char*>(malloc(chunk_size));
+      if (!chunk)
+        throw bad_alloc();
+      MemCount(MEM_AST, chunk_size);
+    }
+    chunks.push_back({chunk, chunk_size});
+    cur = chunk;
+    end = chunk + chunk_size;
+    p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+  }
+  cur = reinterpret_cast<char*>(p + size);
+  byte_cnt += size;
+  return reinterpret_cast<void*>(p);
+}
+
+void Arena::Release() {
+  // reverse order, later objects may refer to earlier ones
+  for (auto it = cleanups.rbegin(); it != cleanups.rend(); ++it)
+    it->dtor(it->obj);
+  cleanups.clear();
+
+  for (auto& chunk : chunks) {
+    if (chunk.size == CHUNK_SIZE && chunk_cache.chunks.size() < chunk_cache_t::MAX_CHUNKS)
+      chunk_cache.chunks.push_back(chunk.data);
+    else
+      free(chunk.data);
+  }
+  chunks.clear();
+  cur = end = nullptr;
+  node_cnt = byte_cnt = 0;
+}
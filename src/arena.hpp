@@ -0,0 +1,90 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// bump allocator owning everything built during one compilation
+// (AST nodes, identifiers, child lists), released at once in Release()
+class Arena {
+ private:
+  static const size_t CHUNK_SIZE = 64 * 1024;
+
+  // objects with a non-trivial destructor still get it called on release
+  struct cleanup_t {
+    void (*dtor)(void*);
+    void* obj;
+  };
+
+  struct chunk_t {
+    char* data;
+    size_t size;
+  };
+
+  vector<chunk_t> chunks;
+  char* cur = nullptr;  // bump pointer in the last chunk
+  char* end = nullptr;
+  vector<cleanup_t> cleanups;
+
+  size_t node_cnt = 0;  // objects created by New
+  size_t byte_cnt = 0;  // bytes handed out by Alloc
+
+  template <typename T>
+  static void Destroy(void* obj) {
+    static_cast<T*>(obj)->~T();
+  }
+
+ public:
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  ~Arena() { Release(); }
+
+  void* Alloc(size_t size, size_t align = alignof(max_align_t));
+
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    T* obj = new (Alloc(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+    if (!is_trivially_destructible<T>::value)
+      cleanups.push_back({&Destroy<T>, obj});
+    node_cnt++;
+    return obj;
+  }
+
+  // destroy all objects and free all chunks (standard ones are kept for the
+  // next arena on this thread), the arena can be reused after
+  void Release();
+
+  size_t nodes() const { return node_cnt; }
+  size_t bytes() const { return byte_cnt; }
+  size_t chunk_num() const { return chunks.size(); }
+};
+
+// STL allocator on top of an arena, deallocate is a no-op
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+  Arena* arena;
+
+  ArenaAllocator(Arena* arena) : arena(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena->Alloc(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, size_t) {}
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+#endif
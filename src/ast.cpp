@@ -1,75 +1,82 @@
 #include <ast.hpp>
-
-static list<int> tmp_var_list;
-
-void DumpFuncType(unique_ptr<string>& type) {
-  if (*type == "int") {
-    cout << ": i32";
-  } else {
-    // do nothing
-    // todo
-    assert(*type == "void");
-  }
-}
-
-void DumpBType(unique_ptr<string>& type) {
-  if (*type == "int") {
-    cout << ": i32";
-  } else {
-    // do nothing
-    assert(*type == "void");
-  }
-}
-
+#include <context.hpp>
+
+namespace {
+// calls the Dump of the concrete class
+class DumpVisitor : public AstVisitor<DumpVisitor> {
+ public:
+  template <typename T>
+  void Visit(T* ast) { ast->Dump(); }
+
+  void VisitCompUnit(CompUnitAST* ast) { Visit(ast); }
+  void VisitFuncDef(FuncDefAST* ast) { Visit(ast); }
+  void VisitFuncFParam(FuncFParamAST* ast) { Visit(ast); }
+  void VisitBlock(BlockAST* ast) { Visit(ast); }
+  void VisitBlockItem(BlockItemAST* ast) { Visit(ast); }
+  void VisitStmt(StmtAST* ast) { Visit(ast); }
+  void VisitAssign(AssignAST* ast) { Visit(ast); }
+  void VisitRet(RetAST* ast) { Visit(ast); }
+  void VisitIf(IfAST* ast) { Visit(ast); }
+  void VisitWhile(WhileAST* ast) { Visit(ast); }
+  void VisitBreak(BreakAST* ast) { Visit(ast); }
+  void VisitContinue(ContinueAST* ast) { Visit(ast); }
+  void VisitDecl(DeclAST* ast) { Visit(ast); }
+  void VisitConstDecl(ConstDeclAST* ast) { Visit(ast); }
+  void VisitConstDef(ConstDefAST* ast) { Visit(ast); }
+  void VisitVarDecl(VarDeclAST* ast) { Visit(ast); }
+  void VisitVarDef(VarDefAST* ast) { Visit(ast); }
+};
+}  // namespace
+
+void BaseAST::Dump() {
+  DumpVisitor().Dispatch(this);
+}
+
+// runtime decls and globals only, see DumpFuncs() in compiler.cpp
 void CompUnitAST::Dump() {
-  cout << "decl @getint(): i32" << endl;
-  cout << "decl @getch(): i32" << endl;
-  cout << "decl @getarray(*i32): i32" << endl;
-  cout << "decl @putint(i32)" << endl;
-  cout << "decl @putch(i32)" << endl;
-  cout << "decl @putarray(i32, *i32)" << endl;
-  cout << "decl @starttime()" << endl;
-  cout << "decl @stoptime()" << endl << endl;
-
-  functab.Insert(string("getint"), string("int"));
-  functab.Insert(string("getch"), string("int"));
-  functab.Insert(string("getarray"), string("int"));
-  functab.Insert(string("putint"), string("void"));
-  functab.Insert(string("putch"), string("void"));
-  functab.Insert(string("putarray"), string("void"));
-  functab.Insert(string("starttime"), string("void"));
-  functab.Insert(string("stoptime"), string("void"));
-
-  symtab_stack.Push();
+  ctx->ir_builder->DeclFunc("getint", {}, &type_i32);
+  ctx->ir_builder->DeclFunc("getch", {}, &type_i32);
+  ctx->ir_builder->DeclFunc("getarray", {&type_i32_ptr}, &type_i32);
+  ctx->ir_builder->DeclFunc("putint", {&type_i32}, &type_unit);
+  ctx->ir_builder->DeclFunc("putch", {&type_i32}, &type_unit);
+  ctx->ir_builder->DeclFunc("putarray", {&type_i32, &type_i32_ptr}, &type_unit);
+  ctx->ir_builder->DeclFunc("starttime", {}, &type_unit);
+  ctx->ir_builder->DeclFunc("stoptime", {}, &type_unit);
+
+  ctx->functab.Insert(ctx->interner.Intern("getint"), TYPE_INT);
+  ctx->functab.Insert(ctx->interner.Intern("getch"), TYPE_INT);
+  ctx->functab.Insert(ctx->interner.Intern("getarray"), TYPE_INT);
+  ctx->functab.Insert(ctx->interner.Intern("putint"), TYPE_VOID);
+  ctx->functab.Insert(ctx->interner.Intern("putch"), TYPE_VOID);
+  ctx->functab.Insert(ctx->interner.Intern("putarray"), TYPE_VOID);
+  ctx->functab.Insert(ctx->interner.Intern("starttime"), TYPE_VOID);
+  ctx->functab.Insert(ctx->interner.Intern("stoptime"), TYPE_VOID);
+
+  ctx->symtab_stack.Push();
 
   for (auto& decl : decl_list) {
-    auto decl_ast = dynamic_cast<DeclAST*>(decl.get());
+    auto decl_ast = decl->As<DeclAST>();
     if (decl_ast->is_var) {
-      auto var_decl = dynamic_cast<VarDeclAST*>(decl_ast->decl.get());
+      auto var_decl = decl_ast->decl->As<VarDeclAST>();
       for (auto& var_def : var_decl->def_list->vec) {
-        auto var_def_ast = dynamic_cast<VarDefAST*>(var_def.get());
-        string var_name = symtab_stack.Insert(var_def_ast->ident);
+        auto var_def_ast = var_def->As<VarDefAST>();
+        string var_name = ctx->symtab_stack.Insert(var_def_ast->ident);
         // todo assert type == int
-        cout << "global " << var_name << " = alloc i32, ";
-        
+
         if (var_def_ast->has_init) {
-          var_def_ast->init->Eval();
-          var_def_ast->init->Dump();
-          string repr = var_def_ast->init->get_repr();
-          if (repr[0] == '@' || repr[0] == '%') {
-            // var
-            cout << "zeroinit" << endl;
-            cout << "store " << repr << ", " << var_name << endl;
-          } else if (repr != "0") {
-            // const number
-            cout << repr << endl;
-          } else if(repr == "0") {
-            cout << "zeroinit" << endl;
+          exp_id_t init = var_def_ast->init;
+          ctx->exps.Eval(init);
+          ctx->exps.Dump(init);
+          if (ctx->exps.IsNumber(init)) {
+            // const number (0 is zeroinit)
+            ctx->ir_builder->GlobalAlloc(var_name, ctx->exps.Value(init));
           } else {
-            assert(false);
+            // var
+            ctx->ir_builder->GlobalAlloc(var_name, 0);
+            ctx->ir_builder->Store(ctx->exps.Repr(init), var_name);
           }
         } else {
-          cout << "zeroinit" << endl;
+          ctx->ir_builder->GlobalAlloc(var_name, 0);
         }
       }
     } else {
@@ -77,97 +84,55 @@ void CompUnitAST::Dump() {
     }
   }
 
-  for (auto& func_def : func_def_list)
-    func_def->Dump();
-  
-  symtab_stack.Pop();
+  // the global scope stays open: every function is dumped later in a
+  // function context that starts from a copy of it
 }
 
 void FuncDefAST::Init() {
   // todo
-  if (*func_type == "void") {
-    is_void = true;
-    functab.Insert(*ident, "void");
-  } else {
-    functab.Insert(*ident, "i32");
-  }
+  is_void = func_type == TYPE_VOID;
+  ctx->functab.Insert(ident, func_type);
 }
 
 void FuncDefAST::Dump() {
-  // modify func ir string lines
-  stringstream tmpss;
-  streambuf* old_buf = cout.rdbuf();
-  cout.rdbuf(tmpss.rdbuf());  // redirect to tmpss
-
   // func head
-  cout << "fun @" << *ident << "(";
+  vector<string> param_names;
   if (has_param) {
-    int param_id = 0;
     for (auto& param : params->vec) {
-      if (param_id++ != 0) {
-        cout << ", ";
-      }
-      param->Dump();
-      param_id++;
+      auto fparam_ast = param->As<FuncFParamAST>();
+      param_names.push_back(ctx->interner.Name(fparam_ast->ident));
     }
     // cast block to BlockAST
-    auto block_ast = dynamic_cast<BlockAST*>(block.get());
-    block_ast->func_params = params.get();
+    auto block_ast = block->As<BlockAST>();
+    block_ast->func_params = params;
   }
-  cout << ")";
-  DumpFuncType(func_type);
-  cout << " {" << endl << "\%entry_" << *ident << ":" << endl;
+  ctx->ir_builder->FuncBegin(ctx->interner.Name(ident), param_names, is_void);
   block->Dump();
-
-  // handle last empty ret block
-  string ir = tmpss.str();
-  string lline;  // last line
-  int pt;  // pointer to ir (inverse)
-  for (pt = ir.length() - 2; ir[pt] != '\n'; pt--)
-    // build last line
-    lline = ir[pt] + lline;
-  if (lline.substr(0, 4) == "%ret")
-    // if last line is ret, remove it
-    ir = ir.substr(0, pt);
-
-  pt = ir.length() - 2;
-  lline = "";
-  while (ir[pt] != '\n')
-    lline = ir[pt--] + lline;
-  if (lline.substr(0, 5) != "  ret") {
-    if (*func_type == "void")
-      ir += "  ret\n";
-    else
-      ir += "  ret 0\n";
-  }
-  cout.rdbuf(old_buf);
-
-  cout << ir;
-  cout << "}" << endl;
+  // the builder adds the default ret if the body falls off its end
+  ctx->ir_builder->FuncEnd();
 }
 
 void FuncFParamAST::Dump() {
-  cout << "@" << *ident;
-  DumpFuncType(type);
+  // params are emitted in the function head by FuncDefAST
 }
 
 void BlockAST::Dump() {
-  symtab_stack.Push();
+  ctx->symtab_stack.Push();
   
   // init funcf params
   if (func_params) {
     for (auto& param : func_params->vec) {
       // cast param to FuncFParamAST
-      auto fparam_ast = dynamic_cast<FuncFParamAST*>(param.get());
-      string mem_addr = symtab_stack.Insert(fparam_ast->ident);
-      cout << "  " << mem_addr << " = alloc i32" << endl;
-      cout << "  store " << "@" << *fparam_ast->ident << ", " << mem_addr << endl;
+      auto fparam_ast = param->As<FuncFParamAST>();
+      string mem_addr = ctx->symtab_stack.Insert(fparam_ast->ident);
+      ctx->ir_builder->Alloc(mem_addr);
+      ctx->ir_builder->Store("@" + ctx->interner.Name(fparam_ast->ident), mem_addr);
     }
   }
 
   for (auto& item : blocks->vec)
     item->Dump();
-  symtab_stack.Pop();
+  ctx->symtab_stack.Pop();
 }
 
 void BlockItemAST::Dump() {
@@ -175,7 +140,7 @@ void BlockItemAST::Dump() {
 }
 
 void DeclAST::Dump() {
-  cout << "  // decl" << endl;
+  ctx->ir_builder->Comment("decl");
   decl->Dump();
 }
 
@@ -187,145 +152,117 @@ void ConstDeclAST::Dump() {
 
 
 void ConstDefAST::Dump() {
-  init->Eval();  // evaluate
-  assert(init->is_number && init->is_const);
-  symtab_stack.Insert(ident, init->val);
-  init->Dump();
-  cout << "  // const def " << *ident << " = " << init->val << endl;
-}
-
-void ConstInitValAST::Dump() {
-  exp->Dump();
-}
-
-void ConstInitValAST::Eval() {
-  if (evaluated) return;
-  
-  exp->Eval();
-  CopyInfo(exp);
-  
-  if (!is_const) evaluated = true;
-}
-
-void ConstExpAST::Dump() {
-  exp->Dump();
-}
-
-void ConstExpAST::Eval() {
-  if (evaluated) return;
-  
-  exp->Eval();
-  is_const = true;
-  is_number = true;
-  evaluated = true;
-  val = exp->val;
-  addr = exp->addr;
-
-  if (!is_const) evaluated = true;
+  ctx->exps.Eval(init);  // evaluate
+  if (!ctx->exps.IsNumber(init))
+    SemanticError("initializer of constant %s is not constant", ctx->interner.Name(ident).c_str());
+  int val = ctx->exps.IsNumber(init) ? ctx->exps.Value(init) : 0;
+  ctx->symtab_stack.Insert(ident, val);
+  ctx->exps.Dump(init);
+  ctx->ir_builder->Comment("const def " + ctx->interner.Name(ident) + " = " + to_string(val));
 }
 
 void StmtAST::Dump() {
-  cout << "  // stmt(exp)" << endl;
+  ctx->ir_builder->Comment("stmt(exp)");
   if (has_exp) {
-    exp->Eval();
-    exp->Dump();
+    ctx->exps.Eval(exp, true);
+    ctx->exps.Dump(exp);
   }
 }
 
 void AssignAST::Dump() {
-  cout << "  // assign stmt" << endl;
+  ctx->ir_builder->Comment("assign stmt");
   // lval = exp
-  lval->Eval();
-  lval->Dump();
-  exp->Eval();
-  exp->Dump();
+  ctx->exps.Eval(lval);
+  ctx->exps.Dump(lval);
+  ctx->exps.Eval(exp);
+  ctx->exps.Dump(exp);
 
   // exp repr is reg, lval repr is addr
-  // cast lval to LValAST
-  auto lval_ast = dynamic_cast<LValAST*>(lval.get());
-  cout << "  store " << exp->get_repr() << ", " << lval_ast->mem_addr << endl;
+  if (ctx->exps.IsNumber(lval))
+    return;  // not a variable, reported by Eval
+  ctx->ir_builder->Store(ctx->exps.Repr(exp), ctx->exps.MemAddr(lval));
 }
 
 void RetAST::Dump() {
-  cout << "  // return stmt" << endl;
+  ctx->ir_builder->Comment("return stmt");
   if (has_exp) {
-    exp->Eval();
-    exp->Dump();
-    cout << "  ret " << exp->get_repr() << endl;
+    ctx->exps.Eval(exp);
+    ctx->exps.Dump(exp);
+    ctx->ir_builder->Ret(ctx->exps.Repr(exp));
   } else {
-    cout << "  ret" << endl;
+    ctx->ir_builder->Ret("");
   }
-  string ret_label = "%ret_" + to_string(ret_label_cnt++);
-  cout << endl << ret_label << ":" << endl;
 }
 
 void IfAST::Dump() {
-  cout << "  // if stmt" << endl;
-  cond->Eval();
-  cond->Dump();
+  ctx->ir_builder->Comment("if stmt");
+  ctx->exps.Eval(cond);
+  ctx->exps.Dump(cond);
 
-  string label_then = "%then_" + to_string(label_cnt);
-  string label_else = "%else_" + to_string(label_cnt);
-  string label_end = "%end_" + to_string(label_cnt);
-  label_cnt++;
+  string label_then = "%then_" + to_string(ctx->label_cnt);
+  string label_else = "%else_" + to_string(ctx->label_cnt);
+  string label_end = "%end_" + to_string(ctx->label_cnt);
+  ctx->label_cnt++;
 
   if (has_else) {
-    cout << "  br " << cond->get_repr() << ", " << label_then << ", " << label_else << endl;
-    cout << endl << label_then << ":" << endl;
+    ctx->ir_builder->Branch(ctx->exps.Repr(cond), label_then, label_else);
+    ctx->ir_builder->Label(label_then);
     if_stmt->Dump();
-    cout << "  jump " << label_end << endl;
-    cout << endl << label_else << ":" << endl;
+    ctx->ir_builder->Jump(label_end);
+    ctx->ir_builder->Label(label_else);
     else_stmt->Dump();
   } else {
-    cout << "  br " << cond->get_repr() << ", " << label_then << ", " << label_end << endl;
-    cout << endl << label_then << ":" << endl;
+    ctx->ir_builder->Branch(ctx->exps.Repr(cond), label_then, label_end);
+    ctx->ir_builder->Label(label_then);
     if_stmt->Dump();
   }
-  cout << "  jump " << label_end << endl;
-  cout << endl << label_end << ":" << endl;
+  ctx->ir_builder->Jump(label_end);
+  ctx->ir_builder->Label(label_end);
 }
 
 void WhileAST::Dump() {
-  cout << "  // while stmt" << endl;
-  labels_t while_labels = while_stack.Push();
+  ctx->ir_builder->Comment("while stmt");
+  labels_t while_labels = ctx->while_stack.Push();
   string label_entry = get<0>(while_labels);
   string label_body = get<1>(while_labels);
   string label_end = get<2>(while_labels);
 
-  cout << "  jump " << label_entry << endl;
+  ctx->ir_builder->Jump(label_entry);
   // entry
-  cout << endl << label_entry << ":" << endl;
-  cond->Eval();
-  cond->Dump();
-  cout << "  br " << cond->get_repr() << ", " << label_body << ", " << label_end << endl;
+  ctx->ir_builder->Label(label_entry);
+  ctx->exps.Eval(cond);
+  ctx->exps.Dump(cond);
+  ctx->ir_builder->Branch(ctx->exps.Repr(cond), label_body, label_end);
 
   // body
-  cout << endl << label_body << ":" << endl;
+  ctx->ir_builder->Label(label_body);
   body->Dump();
-  cout << "  jump " << label_entry << endl;
+  ctx->ir_builder->Jump(label_entry);
 
   // end
-  // todo do i need to remove redundant end label?
-  cout << endl << label_end << ":" << endl;
+  ctx->ir_builder->Label(label_end);
 
-  while_stack.Pop();
+  ctx->while_stack.Pop();
 }
 
 void BreakAST::Dump() {
-  cout << "  // break stmt" << endl;
-  string label_end = get<2>(while_stack.Top());
-  string break_label = label_end + "_break";
-  cout << "  jump " << label_end << endl;
-  // to avoid empty jump in the rest of WhileAST
-  cout << endl << break_label << ":" << endl;
+  ctx->ir_builder->Comment("break stmt");
+  if (ctx->while_stack.Empty()) {
+    SemanticError("break outside of a loop");
+    return;
+  }
+  string label_end = get<2>(ctx->while_stack.Top());
+  ctx->ir_builder->Jump(label_end);
 }
 
 void ContinueAST::Dump() {
-  cout << "  // continue stmt" << endl;
-  string label_entry = get<0>(while_stack.Top());
-  string continue_label = label_entry + "_continue";
-  cout << "  jump " << label_entry << endl;
-  cout << endl << continue_label << ":" << endl;
+  ctx->ir_builder->Comment("continue stmt");
+  if (ctx->while_stack.Empty()) {
+    SemanticError("continue outside of a loop");
+    return;
+  }
+  string label_entry = get<0>(ctx->while_stack.Top());
+  ctx->ir_builder->Jump(label_entry);
 }
 
 void VarDeclAST::Dump() {
@@ -334,547 +271,12 @@ void VarDeclAST::Dump() {
 }
 
 void VarDefAST::Dump() {
-  mem_addr = symtab_stack.Insert(ident);
-  cout << "  " << mem_addr << " = alloc i32" << endl;
+  mem_addr = ctx->symtab_stack.Insert(ident);
+  ctx->ir_builder->Alloc(mem_addr);
   if (has_init) {
-    init->Eval();
-    init->Dump();
+    ctx->exps.Eval(init);
+    ctx->exps.Dump(init);
     // todo only father knows whether is i32
-    cout << "  " << "store " << init->get_repr() << ", " << mem_addr << endl; 
-  }
-}
-
-void InitValAST::Dump() {
-  exp->Dump();
-}
-
-void InitValAST::Eval() {
-  if (evaluated) return;
-  
-  exp->Eval();
-  CopyInfo(exp);
-  
-  if (!is_const) evaluated = true;
-}
-
-void ExpAST::Dump() {
-  lor->Dump();
-}
-
-void ExpAST::Eval() {
-  if (evaluated) return;
-
-  lor->Eval();
-  CopyInfo(lor);
-  
-  if (!is_const) evaluated = true;
-}
-
-void UnaryAST::Dump() {
-  if (op == "") {
-    primary->Dump();
-    return;
-  }
-
-  unary->Dump();
-  if (is_number)
-    cout << "  // " << op << " " << unary->val << " is_number=true" << endl;
-  else {
-    // if (op == "+"): do nothing
-    if (op == "-") {
-      cout << "  " << get_repr() << " = sub 0, " << unary->get_repr() << endl;
-    } else if (op == "!") {
-      cout << "  " << get_repr() << " = eq " << unary->get_repr() << ", 0" << endl;
-    }
-  }
-}
-
-void UnaryAST::Eval() {
-  if (evaluated) return;
-
-  if (op == "") {
-    // unary -> primary
-    primary->Eval();
-    CopyInfo(primary);
-  } else if (op == "+") {
-    // unary -> + primary (do nothing)
-    unary->Eval();
-    CopyInfo(unary);
-  } else {
-    unary->Eval();
-
-    is_number = unary->is_number;
-    is_const = unary->is_const;
-    if (is_number) {
-      if (op == "-") {
-        val = -unary->val;
-      } else if (op == "!") {
-        val = !unary->val;
-      }
-    } else {
-      addr = NewTempVar();
-    }
-  }
-  if (!is_const) evaluated = true;
-}
-
-void PrimaryAST::Dump() {
-  if (is_lval) {
-    lval->Dump();
-  } else if (is_exp) {
-    exp->Dump();
-  }
-}
-
-void PrimaryAST::Eval() {
-  if (evaluated) return;
-
-  // number case is already evaluated when initializing
-  if (is_lval) {  // case: lval
-    lval->Eval();
-    CopyInfo(lval);
-  } else if (is_exp) {  // case: exp
-    exp->Eval();
-    CopyInfo(exp);
-  }
-
-  if (!is_const) evaluated = true;
-}
-
-void LValAST::Dump() {
-  if (!is_number) {
-    // if const: just print the number
-    // todo currently we do not consider optimization when lval is a inconstant number
-    if (!at_left) {
-      // %0 = load @x
-      cout << "  " << get_repr() << " = load " << mem_addr << endl;
-    }
-  } else {
-    cout << "  // " << val << " is_number=true" << endl;
-  }
-}
-
-void LValAST::Eval() {
-  if (evaluated) return;
-
-  sym = symtab_stack.Lookup(ident);
-  if (sym.index() == 0) {
-    // int
-    is_number = true;
-    val = get<int>(sym);
-    assert(!at_left);  // must be a variable and has string
-  } else if (sym.index() == 1) {
-    // string
-    mem_addr = get<string>(sym);
-    if (!at_left)
-      addr = NewTempVar();
-  } else {
-    assert(false);
-  }
-
-  if (!is_const) evaluated = true;
-}
-
-void MulAST::Dump() {
-  if (op == "") {
-    unary->Dump();
-    return;
-  }
-
-  // else
-  mul->Dump();
-  unary->Dump();
-
-  if (is_number) {
-    cout << "  // " << mul->val << " " << op << " " << unary->val << " is_number=true" << endl;
-  } else {  // not number, calculate with reg addr
-    if (op == "*") {
-      cout << "  " << get_repr() << " = mul " << mul->get_repr() << ", "
-          << unary->get_repr() << endl;
-    } else if (op == "/") {
-      cout << "  " << get_repr() << " = div " << mul->get_repr() << ", "
-          << unary->get_repr() << endl;
-    } else if (op == "%") {
-      cout << "  " << get_repr() << " = mod " << mul->get_repr() << ", "
-          << unary->get_repr() << endl;
-    }
-  }
-}
-
-void MulAST::Eval() {
-  if (evaluated) return;
-
-  if (op == "") {
-    // mul -> unary
-    unary->Eval();
-    CopyInfo(unary);
-  } else {
-    // mul -> mul op unary
-    mul->Eval();
-    unary->Eval();
-
-    is_number = mul->is_number && unary->is_number;
-    is_const = mul->is_const && unary->is_const;
-    if (is_number) {
-      if (op == "*") {
-        val = mul->val * unary->val;
-      } else if (op == "/") {
-        val = mul->val / unary->val;
-      } else if (op == "%") {
-        val = mul->val % unary->val;
-      }
-    } else {
-      // create new tmp var
-      addr = NewTempVar();
-    }
-  }
-
-  if (!is_const) evaluated = true;
-}
-
-void AddAST::Dump() {
-  if (op == "") {
-    mul->Dump();
-    return;
-  }
-  
-  // else
-  add->Dump();
-  mul->Dump();
-
-  if (is_number)
-    cout << "  // " << add->val << " " << op << " " << mul->val << " is_number=true" << endl;
-  else {
-    if (op == "+") {
-      cout << "  " << get_repr() << " = add " << add->get_repr() << ", "
-           << mul->get_repr() << endl;
-    } else if (op == "-") {
-      cout << "  " << get_repr() << " = sub " << add->get_repr() << ", "
-           << mul->get_repr() << endl;
-    }
-  }
-}
-
-void AddAST::Eval() {
-  if (evaluated) return;
-  
-  if (op == "") {
-    // add -> mul
-    mul->Eval();
-    CopyInfo(mul);
-  } else {
-    // add -> add op mul
-    add->Eval();
-    mul->Eval();
-
-    is_number = add->is_number && mul->is_number;
-    is_const = add->is_const && mul->is_const;
-    if (is_number) {
-      if (op == "+") {
-        val = add->val + mul->val;
-      } else if (op == "-") {
-        val = add->val - mul->val;
-      }
-    } else {
-      // create new tmp var
-      addr = NewTempVar();
-    }
-  }
-  
-  if (!is_const) evaluated = true;
-}
-
-void RelAST::Dump() {
-  if (op == "") {
-    add->Dump();
-    return;
-  }
-  rel->Dump();
-  add->Dump();
-
-  if (is_number)
-    cout << "  // " << rel->val << " " << op << " " << add->val << " no dump" << endl;
-  else {
-    if (op == "<") {
-      cout << "  " << get_repr() << " = lt " << rel->get_repr() << ", " << add->get_repr() << endl;
-    } else if (op == ">") {
-      cout << "  " << get_repr() << " = gt " << rel->get_repr() << ", " << add->get_repr() << endl;
-    } else if (op == "<=") {
-      cout << "  " << get_repr() << " = le " << rel->get_repr() << ", " << add->get_repr() << endl;
-    } else if (op == ">=") {
-      cout << "  " << get_repr() << " = ge " << rel->get_repr() << ", " << add->get_repr() << endl;
-    }
-  }
-}
-
-void RelAST::Eval() {
-  if (evaluated) return;
-
-  if (op == "") {
-    // rel -> add
-    add->Eval();
-    CopyInfo(add);
-  } else {
-    // rel -> rel op add
-    rel->Eval();
-    add->Eval();
-
-    is_number = rel->is_number && add->is_number;
-    is_const = rel->is_const && add->is_const;
-    if (is_number) {
-      if (op == "<") {
-        val = rel->val < add->val;
-      } else if (op == ">") {
-        val = rel->val > add->val;
-      } else if (op == "<=") {
-        val = rel->val <= add->val;
-      } else if (op == ">=") {
-        val = rel->val >= add->val;
-      }
-    } else {
-      // create new tmp var
-      addr = NewTempVar();
-    }
-  }
-
-  if (!is_const) evaluated = true;
-}
-
-void EqAST::Dump() {
-  if (op == "") {
-    rel->Dump();
-    return;
-  }
-  eq->Dump();
-  rel->Dump();
-
-  if (is_number)
-    cout << "  // " << eq->val << " " << op << " " << rel->val << " no dump" << endl;
-  else {
-    if (op == "==") {
-      cout << "  " << get_repr() << " = eq " << eq->get_repr() << ", " << rel->get_repr() << endl;
-    } else if (op == "!=") {
-      cout << "  " << get_repr() << " = ne " << eq->get_repr() << ", " << rel->get_repr() << endl;
-    }
-  }
-}
-
-void EqAST::Eval() {
-  if (evaluated) return;
-
-  if (op == "") {
-    // eq -> rel
-    rel->Eval();
-    CopyInfo(rel);
-  } else {
-    // eq -> eq op rel
-    eq->Eval();
-    rel->Eval();
-
-    is_number = eq->is_number && rel->is_number;
-    is_const = eq->is_const && rel->is_const;
-    if (is_number) {
-      if (op == "==") {
-        val = eq->val == rel->val;
-      } else if (op == "!=") {
-        val = eq->val != rel->val;
-      }
-    } else {
-      // create new tmp var
-      addr = NewTempVar();
-    }
+    ctx->ir_builder->Store(ctx->exps.Repr(init), mem_addr);
   }
-  
-  if (!is_const) evaluated = true;
-}
-
-void LAndAST::Dump() {
-  if (is_single) {
-    eq->Dump();
-    return;
-  }
-
-  if (is_number) {
-    land->Dump();
-    eq->Dump();
-    cout << "  // " << land->val << " && " << eq->val << " no dump" << endl;
-  } else {
-    /* short circuit: 
-     * int result = 0;
-     * if (lhs != 0) {
-     *   result = rhs != 0;
-     * }
-     */
-
-    // prepare label for short circuit
-    land->Dump();
-    string label_then = "%then_" + to_string(label_cnt);
-    string label_else = "%else_" + to_string(label_cnt);
-    string label_end = "%end_" + to_string(label_cnt);
-    label_cnt++;
-
-    // create result on stack
-    string result = "%" + to_string(tmp_var_no++);
-    cout << "  " << result << " = alloc i32" << endl;
-    // if lhs != 0 -> label_then, else label_else
-    cout << "  br " << land->get_repr() << ", " << label_then << ", " << label_else << endl;
-    cout << label_then << ":" << endl;
-    string tmp_rhs = "%" + to_string(tmp_var_no++);
-    // result = rhs != 0
-    eq->Dump();
-    cout << "  " << tmp_rhs << " = ne " << eq->get_repr() << ", 0" << endl;
-    cout << "  store " << tmp_rhs << ", " << result << endl;
-    cout << "  jump " << label_end << endl;
-    // label else (result = 0)
-    cout << label_else << ":" << endl;
-    cout << "  store 0, " << result << endl;
-    cout << "  jump " << label_end << endl;
-    // label end
-    cout << label_end << ":" << endl;
-    cout << "  " << get_repr() << " = load " << result << endl;
-  }
-}
-
-void LAndAST::Eval() {
-  // todo consider short-circuit in eval
-  if (evaluated) return;
-
-  if (is_single) {
-    // land -> eq
-    eq->Eval();
-    CopyInfo(eq);
-  } else {
-    // land -> land op eq
-    land->Eval();
-    eq->Eval();
-
-    is_number = land->is_number && eq->is_number;
-    is_const = land->is_const && eq->is_const;
-    if (is_number) {
-      val = land->val && eq->val;
-    } else {
-      // create new tmp var
-      addr = NewTempVar();
-    }
-  }
-  
-  if (!is_const) evaluated = true;
-}
-
-void LOrAST::Dump() {
-  if (is_single) {
-    land->Dump();
-    return;
-  }
-
-  if (is_number) {
-    lor->Dump();
-    land->Dump();
-    cout << "  // " << lor->val << " || " << land->val << " no dump" << endl;
-  }  else {
-    /* short circuit: 
-     * int result = 1;
-     * if (lhs == 0) {
-     *   result = rhs != 0;
-     * }
-     */
-
-    lor->Dump();
-    string label_then = "%then_" + to_string(label_cnt);
-    string label_else = "%else_" + to_string(label_cnt);
-    string label_end = "%end_" + to_string(label_cnt);
-    label_cnt++;
-
-    // create result on stack
-    string result = "%" + to_string(tmp_var_no++);
-    cout << "  " << result << " = alloc i32" << endl;
-    // if lhs == 0 -> label_then, else label_else
-    cout << "  br " << lor->get_repr() << ", " << label_else << ", " << label_then << endl;
-    cout << label_then << ":" << endl;
-    string tmp_rhs = "%" + to_string(tmp_var_no++);
-    // result = rhs != 0
-    land->Dump();
-    cout << "  " << tmp_rhs << " = ne " << land->get_repr() << ", 0" << endl;
-    cout << "  store " << tmp_rhs << ", " << result << endl;
-    cout << "  jump " << label_end << endl;
-    // label else (result = 1)
-    cout << label_else << ":" << endl;
-    cout << "  store 1, " << result << endl;
-    cout << "  jump " << label_end << endl;
-    // label end
-    cout << label_end << ":" << endl;
-    cout << "  " << get_repr() << " = load " << result << endl;
-  }
-}
-
-void LOrAST::Eval() {
-  if (evaluated) return;
-
-  if (is_single) {
-    // lor -> land
-    land->Eval();
-    CopyInfo(land);
-  } else {
-    // lor -> lor op land
-    lor->Eval();
-    land->Eval();
-
-    is_number = lor->is_number && land->is_number;
-    is_const = lor->is_const && land->is_const;
-    if (is_number) {
-      val = lor->val || land->val;
-    } else {
-      // create new tmp var
-      addr = NewTempVar();
-    }
-  }
-  
-  if (!is_const) evaluated = true;
-}
-
-void FuncCallAST::Dump() {
-  // %0 = call @half(10, %2)
-  if (has_rparams) {
-    for (auto& rparam : rparams->vec)
-      rparam->Dump();
-  }
-
-  string func_type = functab.Lookup(ident);
-  if (func_type == "void") {
-    cout << "  ";
-  } else {
-    // assert(sym_val == "i32");
-    cout << "  " << get_repr() << " = ";
-  }
-  cout << "call @" << *ident << "(";
-  
-  if (has_rparams) {
-    int param_cnt = 0;
-    for (auto& param : rparams->vec) {
-      auto param_ast = dynamic_cast<ExpBaseAST*>(param.get());
-      if (param_cnt++ > 0) {
-        cout << ", ";
-      }
-      cout << param_ast->get_repr();
-    }
-  }
-
-  cout << ")" << endl;
-}
-
-void FuncCallAST::Eval() {
-  // todo need to search function table
-  if (evaluated) return;
-
-  if (has_rparams) {
-    for (auto& rparam : rparams->vec) {
-      auto rparam_ast = dynamic_cast<ExpBaseAST*>(rparam.get());
-      rparam_ast->Eval();
-    }
-  }
-
-  evaluated = true;
-  is_number = false;
-  is_const = false;
-  addr = NewTempVar();
 }
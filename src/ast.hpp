@@ -1,6 +1,9 @@
 #ifndef AST_H
 #define AST_H
 
+#include <arena.hpp>
+#include <builder.hpp>
+#include <exp.hpp>
 #include <global.hpp>
 #include <koopa.h>
 
@@ -8,14 +11,12 @@
 #include <iostream>
 #include <list>
 #include <vector>
-#include <memory>
 #include <sstream>
 #include <string>
 
 using namespace std;
 
 class BaseAST;
-class ExpBaseAST;
 class VecAST;
 
 class FuncDefAST;
@@ -33,466 +34,312 @@ class DeclAST;
 class ConstDeclAST;
 class VarDeclAST;
 
-class ConstDefAST;      // expbase
-class VarDefAST;        // expbase
-class ConstInitValAST;  // expbase
-class ConstExpAST;      // expbase
-class InitValAST;       // expbase
-
-class ExpAST;
-class UnaryAST;
-class PrimaryAST;
-class LValAST;
-class MulAST;
-class AddAST;
-class RelAST;
-class EqAST;
-class LAndAST;
-class LorAST;
-class FuncCallAST;
+class ConstDefAST;
+class VarDefAST;
+
+// expressions are not AST nodes: they live in ctx->exps and statements
+// refer to them by id (see exp.hpp)
+
+// one kind per concrete AST class
+typedef enum : uint8_t {
+  AST_COMP_UNIT,
+  AST_FUNC_DEF,
+  AST_FUNC_FPARAM,
+  AST_BLOCK,
+  AST_BLOCK_ITEM,
+  AST_STMT,
+  AST_ASSIGN,
+  AST_RET,
+  AST_IF,
+  AST_WHILE,
+  AST_BREAK,
+  AST_CONTINUE,
+  AST_DECL,
+  AST_CONST_DECL,
+  AST_CONST_DEF,
+  AST_VAR_DECL,
+  AST_VAR_DEF,
+} ast_kind_t;
 
 // 所有 AST 的基类
+// no virtual methods: passes switch on kind (see AstVisitor) and the arena
+// runs the destructor of the concrete class
 class BaseAST {
  public:
-  virtual ~BaseAST() = default;
-  virtual void Dump() = 0;  // overide <<
+  const ast_kind_t kind;
+
+  explicit BaseAST(ast_kind_t kind) : kind(kind) {}
+  void Dump();  // lowering to koopa, calls the Dump of the concrete class
+
+  // checked downcast
+  template <typename T>
+  T* As() {
+    assert(kind == T::KIND);
+    return static_cast<T*>(this);
+  }
 };
 
-class VecAST {
+// base of the concrete classes, fixes the kind
+template <ast_kind_t K>
+class AstNode : public BaseAST {
  public:
-  vector<unique_ptr<BaseAST>> vec;
+  static const ast_kind_t KIND = K;
 
-  void push_back(unique_ptr<BaseAST>& ast) {
-    vec.push_back(move(ast));
-  }
+  AstNode() : BaseAST(K) {}
 };
 
-// currently, it only contains one unary expression
-class ExpBaseAST : public BaseAST {
+// child list, the buffer lives in the arena as well
+class VecAST {
  public:
-  bool evaluated = false;  // avoid re-evaluation (only for const exp)
-  bool is_number = false;  // const number
-  bool is_const = false;   // is const expression (so no re-evaluate)
-  int val;
-  string addr;
-
-  // go through all the downstream nodes and get the value and address
-  // 1. whether the node is a number node
-  // 2. get the address: if it is a number node, the address is the number, else
-  // the address is the register
-  virtual void Eval() = 0;
-  
-  // if number than return val, else return tmp var
-  virtual string get_repr() {
-    if (is_number) {
-      return to_string(val);
-    } else {
-      return addr;
-    }
-  }
-  
-  void CopyInfo(unique_ptr<ExpBaseAST>& exp) {
-    evaluated = exp->evaluated;
-    is_number = exp->is_number;
-    is_const = exp->is_const;
-    val = exp->val;
-    addr = exp->addr;
-  }
-  
-  virtual string DebugInfo() {
-    stringstream buffer;
-    if (is_number) {
-      buffer << "is number: " << val;
-    } else {
-      buffer << "not number, addr: " << addr;
-    }
-    return buffer.str();
+  vector<BaseAST*, ArenaAllocator<BaseAST*>> vec;
+
+  VecAST(Arena& arena) : vec(ArenaAllocator<BaseAST*>(&arena)) {}
+
+  void push_back(BaseAST* ast) {
+    vec.push_back(ast);
   }
 };
 
-class CompUnitAST : public BaseAST {
+class CompUnitAST : public AstNode<AST_COMP_UNIT> {
  public:
-  vector<unique_ptr<BaseAST>> func_def_list;
-  vector<unique_ptr<BaseAST>> decl_list;
+  vector<BaseAST*> func_def_list;
+  vector<BaseAST*> decl_list;
 
   CompUnitAST() {}
   // TODO is there any way to keep const?
-  virtual void Dump() override;
+  void Dump();
 };
 
 // FuncDef 也是 BaseAST
-class FuncDefAST : public BaseAST {
+class FuncDefAST : public AstNode<AST_FUNC_DEF> {
  public:
-  unique_ptr<string> func_type;
-  unique_ptr<string> ident;
-  unique_ptr<VecAST> params;
-  unique_ptr<BaseAST> block;
+  btype_t func_type;
+  sym_id_t ident;
+  VecAST* params = nullptr;
+  BaseAST* block = nullptr;
   bool has_param = false;
   bool is_void = false;
+  int first_token = 0;  // token span in the source, see Lexer
+  int last_token = 0;
 
   // TODO 有空了梳理一下string内存管理
-  FuncDefAST(unique_ptr<string>& func_type, unique_ptr<string>& ident, unique_ptr<BaseAST>& block)
-      : func_type(move(func_type)), ident(move(ident)), block(move(block)) {
+  FuncDefAST(btype_t func_type, sym_id_t ident, BaseAST* block)
+      : func_type(func_type), ident(ident), block(block) {
     Init();
   }
-  FuncDefAST(unique_ptr<string>& func_type, unique_ptr<string>& ident, unique_ptr<VecAST>& params, unique_ptr<BaseAST>& block)
-      : func_type(move(func_type)), ident(move(ident)), params(move(params)), block(move(block)), has_param(true) {
+  FuncDefAST(btype_t func_type, sym_id_t ident, VecAST* params, BaseAST* block)
+      : func_type(func_type), ident(ident), params(params), block(block), has_param(true) {
     Init();
   }
 
-  virtual void Dump() override;
+  void Dump();
 
  private:
   void Init();
 };
 
-class FuncFParamAST : public BaseAST {
+class FuncFParamAST : public AstNode<AST_FUNC_FPARAM> {
  public:
-  unique_ptr<string> type;
-  unique_ptr<string> ident;
+  btype_t type;
+  sym_id_t ident;
 
-  FuncFParamAST(unique_ptr<string>& type, unique_ptr<string>& ident)
-      : type(move(type)), ident(move(ident)) {}
+  FuncFParamAST(btype_t type, sym_id_t ident)
+      : type(type), ident(ident) {}
 
-  virtual void Dump() override;
+  void Dump();
 };
 
-class BlockAST : public BaseAST {
+class BlockAST : public AstNode<AST_BLOCK> {
  public:
-  unique_ptr<VecAST> blocks;  // block item list
+  VecAST* blocks = nullptr;  // block item list
   VecAST* func_params = nullptr;
 
-  BlockAST(unique_ptr<VecAST>& blocks) : blocks(move(blocks)) {}
-  virtual void Dump() override;
+  BlockAST(VecAST* blocks) : blocks(blocks) {}
+  void Dump();
 };
 
-class BlockItemAST : public BaseAST {
+class BlockItemAST : public AstNode<AST_BLOCK_ITEM> {
  public:
-  unique_ptr<BaseAST> ast;
+  BaseAST* ast = nullptr;
   bool is_stmt;  // stmt or decl
 
-  BlockItemAST(unique_ptr<BaseAST>& ast, bool is_stmt)
-      : ast(move(ast)), is_stmt(is_stmt) {}
-  virtual void Dump() override;
+  BlockItemAST(BaseAST* ast, bool is_stmt)
+      : ast(ast), is_stmt(is_stmt) {}
+  void Dump();
 };
 
-class StmtAST : public BaseAST {
+class StmtAST : public AstNode<AST_STMT> {
  public:
-  unique_ptr<ExpBaseAST> exp;
+  exp_id_t exp = 0;
   bool has_exp = false;
 
   StmtAST() {}
-  StmtAST(unique_ptr<ExpBaseAST>& exp) : exp(move(exp)), has_exp(true) {}
-  virtual void Dump() override;
+  StmtAST(exp_id_t exp) : exp(exp), has_exp(true) {}
+  void Dump();
 };
 
 // Another StmtAST
-class AssignAST : public BaseAST {
+class AssignAST : public AstNode<AST_ASSIGN> {
  public:
-  unique_ptr<ExpBaseAST> lval;
-  unique_ptr<ExpBaseAST> exp;
+  exp_id_t lval = 0;
+  exp_id_t exp = 0;
 
-  AssignAST(unique_ptr<ExpBaseAST>& lval, unique_ptr<ExpBaseAST>& exp)
-      : lval(move(lval)), exp(move(exp)) {}
-  virtual void Dump() override;
+  AssignAST(exp_id_t lval, exp_id_t exp)
+      : lval(lval), exp(exp) {}
+  void Dump();
 };
 
 // Another StmtAST
-class RetAST : public BaseAST {
+class RetAST : public AstNode<AST_RET> {
  public:
-  unique_ptr<ExpBaseAST> exp;
+  exp_id_t exp = 0;
   bool has_exp = false;
 
   RetAST() {}
-  RetAST(unique_ptr<ExpBaseAST>& exp) : exp(move(exp)), has_exp(true) {}
-  virtual void Dump() override;
+  RetAST(exp_id_t exp) : exp(exp), has_exp(true) {}
+  void Dump();
 };
 
-class IfAST : public BaseAST {
+class IfAST : public AstNode<AST_IF> {
  public:
-  unique_ptr<ExpBaseAST> cond;
-  unique_ptr<BaseAST> if_stmt;
-  unique_ptr<BaseAST> else_stmt;
+  exp_id_t cond = 0;
+  BaseAST* if_stmt = nullptr;
+  BaseAST* else_stmt = nullptr;
   bool has_else = false;
 
-  IfAST(unique_ptr<ExpBaseAST>& cond, unique_ptr<BaseAST>& if_stmt)
-      : cond(move(cond)), if_stmt(move(if_stmt)) {}
-  IfAST(unique_ptr<ExpBaseAST>& cond, unique_ptr<BaseAST>& if_stmt,
-        unique_ptr<BaseAST>& else_stmt)
-      : cond(move(cond)), if_stmt(move(if_stmt)), else_stmt(move(else_stmt)),
+  IfAST(exp_id_t cond, BaseAST* if_stmt)
+      : cond(cond), if_stmt(if_stmt) {}
+  IfAST(exp_id_t cond, BaseAST* if_stmt,
+        BaseAST* else_stmt)
+      : cond(cond), if_stmt(if_stmt), else_stmt(else_stmt),
         has_else(true) {}
-  virtual void Dump() override;
+  void Dump();
 };
 
-class WhileAST : public BaseAST {
+class WhileAST : public AstNode<AST_WHILE> {
  public:
-  unique_ptr<ExpBaseAST> cond;
-  unique_ptr<BaseAST> body;
+  exp_id_t cond = 0;
+  BaseAST* body = nullptr;
 
-  WhileAST(unique_ptr<ExpBaseAST>& cond, unique_ptr<BaseAST>& stmt)
-      : cond(move(cond)), body(move(stmt)) {}
-  virtual void Dump() override;
+  WhileAST(exp_id_t cond, BaseAST* stmt)
+      : cond(cond), body(stmt) {}
+  void Dump();
 };
 
-class BreakAST : public BaseAST {
+class BreakAST : public AstNode<AST_BREAK> {
  public:
-  virtual void Dump() override;
+  void Dump();
 };
 
-class ContinueAST : public BaseAST {
+class ContinueAST : public AstNode<AST_CONTINUE> {
  public:
-  virtual void Dump() override;
+  void Dump();
 };
 
-class DeclAST : public BaseAST {
+class DeclAST : public AstNode<AST_DECL> {
  public:
-  unique_ptr<BaseAST> decl;
+  BaseAST* decl = nullptr;
   bool is_var;  // todo use global type in future
 
-  DeclAST(unique_ptr<BaseAST>& decl, bool is_var) : decl(move(decl)), is_var(is_var) {}
-  virtual void Dump() override;
+  DeclAST(BaseAST* decl, bool is_var) : decl(decl), is_var(is_var) {}
+  void Dump();
 };
 
-class ConstDeclAST : public BaseAST {
+class ConstDeclAST : public AstNode<AST_CONST_DECL> {
  public:
-  unique_ptr<string> btype;
-  unique_ptr<VecAST> def_list;
+  btype_t btype;
+  VecAST* def_list = nullptr;
 
-  ConstDeclAST(unique_ptr<string>& btype, unique_ptr<VecAST>& def_list)
-      : btype(move(btype)), def_list(move(def_list)) {}
-  virtual void Dump() override;
+  ConstDeclAST(btype_t btype, VecAST* def_list)
+      : btype(btype), def_list(def_list) {}
+  void Dump();
 };
 
 
-class ConstDefAST : public BaseAST {
- public:
-  unique_ptr<string> ident;     // symtab
-  unique_ptr<ExpBaseAST> init;  // init value
-
-  ConstDefAST(unique_ptr<string>& ident_, unique_ptr<ExpBaseAST>& init_)
-      : ident(move(ident_)), init(move(init_)) {}
-  virtual void Dump() override;
-};
-
-class ConstInitValAST : public ExpBaseAST {
- public:
-  unique_ptr<ExpBaseAST> exp;  // const exp
-
-  ConstInitValAST(unique_ptr<ExpBaseAST>& exp) : exp(move(exp)) {}
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-class ConstExpAST : public ExpBaseAST {
+class ConstDefAST : public AstNode<AST_CONST_DEF> {
  public:
-  unique_ptr<ExpBaseAST> exp;
+  sym_id_t ident;     // symtab
+  exp_id_t init = 0;  // init value
 
-  ConstExpAST(unique_ptr<ExpBaseAST>& exp) : exp(move(exp)) {}
-  virtual void Dump() override;
-  virtual void Eval() override;
+  ConstDefAST(sym_id_t ident_, exp_id_t init_)
+      : ident(ident_), init(init_) {}
+  void Dump();
 };
 
-class VarDeclAST : public BaseAST {
+class VarDeclAST : public AstNode<AST_VAR_DECL> {
  public:
-  unique_ptr<string> btype;
-  unique_ptr<VecAST> def_list;
+  btype_t btype;
+  VecAST* def_list = nullptr;
 
-  VarDeclAST(unique_ptr<string>& btype, unique_ptr<VecAST>& def_list)
-      : btype(move(btype)), def_list(move(def_list)) {}
-  virtual void Dump() override;
+  VarDeclAST(btype_t btype, VecAST* def_list)
+      : btype(btype), def_list(def_list) {}
+  void Dump();
 };
 
-class VarDefAST : public BaseAST {
+class VarDefAST : public AstNode<AST_VAR_DEF> {
  public:
-  unique_ptr<string> ident;
-  unique_ptr<ExpBaseAST> init;
+  sym_id_t ident;
+  exp_id_t init = 0;
   string mem_addr;
   bool has_init;
 
-  VarDefAST(unique_ptr<string>& ident_) : ident(move(ident_)), has_init(false) {}
-
-  VarDefAST(unique_ptr<string>& ident_, unique_ptr<ExpBaseAST>& init_)
-      : ident(move(ident_)), init(move(init_)), has_init(true) {}
-
-  virtual void Dump() override;
-};
-
-class InitValAST : public ExpBaseAST {
- public:
-  unique_ptr<ExpBaseAST> exp;
-
-  InitValAST(unique_ptr<ExpBaseAST>& exp) : exp(move(exp)) {}
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-class ExpAST : public ExpBaseAST {
- public:
-  unique_ptr<ExpBaseAST> lor;
-
-  ExpAST(unique_ptr<ExpBaseAST>& add) : lor(move(add)) {}
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-// unary expression, op could be none
-class UnaryAST : public ExpBaseAST {
- public:
-  string op;  // maybe I can use enum here, default none string
-  // union {
-  //   unique_ptr<ExpBaseAST> primary;  // primary expression
-  //   unique_ptr<ExpBaseAST> unary;    // unary
-  // };
-  unique_ptr<ExpBaseAST> primary;  // primary expression
-  unique_ptr<ExpBaseAST> unary;    // unary
-
-  // todo what is move and unique_ptr
-  UnaryAST(unique_ptr<ExpBaseAST>& primary) : primary(move(primary)) {}
-  UnaryAST(string* op, unique_ptr<ExpBaseAST>& unary)
-      : op(*move(op)), unary(move(unary)) {}
-  virtual void Dump() override;
-  virtual void Eval() override;
-  virtual string DebugInfo() override {
-    string base_debug_info = ExpBaseAST::DebugInfo();
-    stringstream buffer;
-    buffer << base_debug_info << " op: " << op;
-    return buffer.str();
-  }
-};
-
-// number or parathesis expression
-class PrimaryAST : public ExpBaseAST {
- public:
-  bool is_lval = false;
-  bool is_exp = false;
-  unique_ptr<ExpBaseAST> exp;
-  unique_ptr<ExpBaseAST> lval;
-
-  PrimaryAST(unique_ptr<ExpBaseAST>& ast, bool is_lval) {
-    this->is_lval = is_lval;
-    this->is_exp = !is_lval;
-    if (is_lval) {
-      lval = move(ast);
-    } else {
-      exp = move(ast);
+  VarDefAST(sym_id_t ident_) : ident(ident_), has_init(false) {}
+
+  VarDefAST(sym_id_t ident_, exp_id_t init_)
+      : ident(ident_), init(init_), has_init(true) {}
+
+  void Dump();
+};
+
+// static visitor: Derived defines Visit<Kind> for the kinds it handles,
+// the others go to VisitDefault. Dispatch is one switch on the kind, no
+// virtual call and no RTTI
+template <typename Derived, typename R = void>
+class AstVisitor {
+ public:
+  R Dispatch(BaseAST* ast) {
+    Derived* self = static_cast<Derived*>(this);
+    switch (ast->kind) {
+      case AST_COMP_UNIT: return self->VisitCompUnit(static_cast<CompUnitAST*>(ast));
+      case AST_FUNC_DEF: return self->VisitFuncDef(static_cast<FuncDefAST*>(ast));
+      case AST_FUNC_FPARAM: return self->VisitFuncFParam(static_cast<FuncFParamAST*>(ast));
+      case AST_BLOCK: return self->VisitBlock(static_cast<BlockAST*>(ast));
+      case AST_BLOCK_ITEM: return self->VisitBlockItem(static_cast<BlockItemAST*>(ast));
+      case AST_STMT: return self->VisitStmt(static_cast<StmtAST*>(ast));
+      case AST_ASSIGN: return self->VisitAssign(static_cast<AssignAST*>(ast));
+      case AST_RET: return self->VisitRet(static_cast<RetAST*>(ast));
+      case AST_IF: return self->VisitIf(static_cast<IfAST*>(ast));
+      case AST_WHILE: return self->VisitWhile(static_cast<WhileAST*>(ast));
+      case AST_BREAK: return self->VisitBreak(static_cast<BreakAST*>(ast));
+      case AST_CONTINUE: return self->VisitContinue(static_cast<ContinueAST*>(ast));
+      case AST_DECL: return self->VisitDecl(static_cast<DeclAST*>(ast));
+      case AST_CONST_DECL: return self->VisitConstDecl(static_cast<ConstDeclAST*>(ast));
+      case AST_CONST_DEF: return self->VisitConstDef(static_cast<ConstDefAST*>(ast));
+      case AST_VAR_DECL: return self->VisitVarDecl(static_cast<VarDeclAST*>(ast));
+      case AST_VAR_DEF: return self->VisitVarDef(static_cast<VarDefAST*>(ast));
     }
+    assert(false);
+    return R();
   }
-  PrimaryAST(int value) {
-    is_number = true;
-    is_const = true;
-    evaluated = true;
-    val = value;
-  }
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-class LValAST : public ExpBaseAST {
- public:
-  unique_ptr<string> ident;
-  sym_t sym;
-  string mem_addr;  // address in memory
-  bool at_left;
-
-  LValAST(unique_ptr<string>& ident_) : ident(move(ident_)) {}
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-class MulAST : public ExpBaseAST {
- public:
-  string op;
-  unique_ptr<ExpBaseAST> mul;
-  unique_ptr<ExpBaseAST> unary;
-
-  MulAST(unique_ptr<ExpBaseAST>& unary) : unary(move(unary)) {}
-  MulAST(string op, unique_ptr<ExpBaseAST>& mul, unique_ptr<ExpBaseAST>& unary)
-      : op(move(op)), mul(move(mul)), unary(move(unary)) {}
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
 
-class AddAST : public ExpBaseAST {
- public:
-  string op;
-  unique_ptr<ExpBaseAST> add;
-  unique_ptr<ExpBaseAST> mul;
-
-  AddAST(unique_ptr<ExpBaseAST>& mul) : mul(move(mul)) {}
-  AddAST(string op, unique_ptr<ExpBaseAST>& add, unique_ptr<ExpBaseAST>& mul)
-      : op(move(op)), add(move(add)), mul(move(mul)) {}
-
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-class RelAST : public ExpBaseAST {
- public:
-  string op;
-  unique_ptr<ExpBaseAST> rel;
-  unique_ptr<ExpBaseAST> add;
-
-  RelAST(unique_ptr<ExpBaseAST>& add) : add(move(add)) {}
-  RelAST(string* op, unique_ptr<ExpBaseAST>& rel, unique_ptr<ExpBaseAST>& add)
-      : op(*move(op)), rel(move(rel)), add(move(add)) {}
-
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-class EqAST : public ExpBaseAST {
- public:
-  string op;
-  unique_ptr<ExpBaseAST> eq;
-  unique_ptr<ExpBaseAST> rel;
-
-  EqAST(unique_ptr<ExpBaseAST>& rel) : rel(move(rel)) {}
-  EqAST(string* op, unique_ptr<ExpBaseAST>& eq, unique_ptr<ExpBaseAST>& rel)
-      : op(*move(op)), eq(move(eq)), rel(move(rel)) {}
-
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-class LAndAST : public ExpBaseAST {
- public:
-  bool is_single;
-  unique_ptr<ExpBaseAST> land;
-  unique_ptr<ExpBaseAST> eq;
-
-  LAndAST(unique_ptr<ExpBaseAST>& eq) :is_single(true), eq(move(eq)) {}
-  LAndAST(unique_ptr<ExpBaseAST>& land, unique_ptr<ExpBaseAST>& eq)
-      : is_single(false), land(move(land)), eq(move(eq)) {}
-
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-class LOrAST : public ExpBaseAST {
- public:
-  bool is_single;
-  unique_ptr<ExpBaseAST> lor;
-  unique_ptr<ExpBaseAST> land;
-
-  LOrAST(unique_ptr<ExpBaseAST>& land) : is_single(true), land(move(land)) {}
-  LOrAST(unique_ptr<ExpBaseAST>& lor, unique_ptr<ExpBaseAST>& land)
-      : is_single(false), lor(move(lor)), land(move(land)) {}
-
-  virtual void Dump() override;
-  virtual void Eval() override;
-};
-
-class FuncCallAST : public ExpBaseAST {
- public:
-  unique_ptr<string> ident;
-  unique_ptr<VecAST> rparams;
-  bool has_rparams = false;
-
-  FuncCallAST(unique_ptr<string>& ident) : ident(move(ident)) {}
-  FuncCallAST(unique_ptr<string>& ident, unique_ptr<VecAST>& rparams) 
-      : ident(move(ident)), rparams(move(rparams)), has_rparams(true) {}
-  virtual void Dump() override;
-  virtual void Eval() override;
+  R VisitDefault(BaseAST* ast) { return R(); }
+  R VisitCompUnit(CompUnitAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitFuncDef(FuncDefAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitFuncFParam(FuncFParamAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitBlock(BlockAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitBlockItem(BlockItemAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitStmt(StmtAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitAssign(AssignAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitRet(RetAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitIf(IfAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitWhile(WhileAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitBreak(BreakAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitContinue(ContinueAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitDecl(DeclAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitConstDecl(ConstDeclAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitConstDef(ConstDefAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitVarDecl(VarDeclAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
+  R VisitVarDef(VarDefAST* ast) { return static_cast<Derived*>(this)->VisitDefault(ast); }
 };
 
 #endif
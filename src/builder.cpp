@@ -0,0 +1,455 @@
+#include <builder.hpp>
+
+#include <memstat.hpp>
+
+#include <cassert>
+#include <cstdlib>
+
+const koopa_raw_type_kind_t type_i32 = {KOOPA_RTT_INT32, {}};
+const koopa_raw_type_kind_t type_unit = {KOOPA_RTT_UNIT, {}};
+
+static koopa_raw_type_kind_t make_pointer(koopa_raw_type_t base) {
+  koopa_raw_type_kind_t ty;
+  ty.tag = KOOPA_RTT_POINTER;
+  ty.data.pointer.base = base;
+  return ty;
+}
+const koopa_raw_type_kind_t type_i32_ptr = make_pointer(&type_i32);
+
+static const char* binary_op_name(koopa_raw_binary_op_t op) {
+  static const char* names[] = {
+    "ne", "eq", "gt", "lt", "ge", "le", "add", "sub", "mul",
+    "div", "mod", "and", "or", "xor", "shl", "shr", "sar",
+  };
+  assert(op < sizeof(names) / sizeof(names[0]));
+  return names[op];
+}
+
+static string type_name(koopa_raw_type_t ty) {
+  switch (ty->tag) {
+    case KOOPA_RTT_INT32:
+      return "i32";
+    case KOOPA_RTT_POINTER:
+      return "*" + type_name(ty->data.pointer.base);
+    default:
+      assert(false);
+  }
+  return "";
+}
+
+// ==================== IRBuilder ==================== //
+
+void IRBuilder::FuncBegin(const string& name, const vector<string>& params, bool is_void) {
+  MemScope mem(MEM_IR);
+  this->is_void = is_void;
+  reachable = true;
+  terminated = false;
+  targets.clear();
+  EmitFuncBegin(name, params, is_void);
+}
+
+void IRBuilder::FuncEnd() {
+  MemScope mem(MEM_IR);
+  // falls off the end: default return
+  if (Live())
+    Ret(is_void ? "" : "0");
+  EmitFuncEnd();
+}
+
+void IRBuilder::Label(const string& label) {
+  MemScope mem(MEM_IR);
+  // fall through into the new block
+  if (Live())
+    Jump(label);
+
+  // blocks are always jumped to before placed, except loop back edges
+  // which come from inside the loop, so an unreferenced label is dead
+  reachable = targets.count(label);
+  terminated = false;
+  if (reachable)
+    EmitLabel(label);
+}
+
+void IRBuilder::Comment(const string& text) {
+  MemScope mem(MEM_IR);
+  if (Live())
+    EmitComment(text);
+}
+
+void IRBuilder::Alloc(const string& dst) {
+  MemScope mem(MEM_IR);
+  if (Live())
+    EmitAlloc(dst);
+}
+
+void IRBuilder::Load(const string& dst, const string& src) {
+  MemScope mem(MEM_IR);
+  if (Live())
+    EmitLoad(dst, src);
+}
+
+void IRBuilder::Store(const string& val, const string& dst) {
+  MemScope mem(MEM_IR);
+  if (Live())
+    EmitStore(val, dst);
+}
+
+void IRBuilder::Binary(koopa_raw_binary_op_t op, const string& dst, const string& lhs, const string& rhs) {
+  MemScope mem(MEM_IR);
+  if (Live())
+    EmitBinary(op, dst, lhs, rhs);
+}
+
+void IRBuilder::Branch(const string& cond, const string& label_true, const string& label_false) {
+  MemScope mem(MEM_IR);
+  if (!Live())
+    return;
+  targets.insert(label_true);
+  targets.insert(label_false);
+  EmitBranch(cond, label_true, label_false);
+  terminated = true;
+}
+
+void IRBuilder::Jump(const string& label) {
+  MemScope mem(MEM_IR);
+  if (!Live())
+    return;
+  targets.insert(label);
+  EmitJump(label);
+  terminated = true;
+}
+
+void IRBuilder::Ret(const string& val) {
+  MemScope mem(MEM_IR);
+  if (!Live())
+    return;
+  EmitRet(val);
+  terminated = true;
+}
+
+void IRBuilder::Call(const string& dst, const string& func, const vector<string>& args) {
+  MemScope mem(MEM_IR);
+  if (Live())
+    EmitCall(dst, func, args);
+}
+
+// ==================== TextIRBuilder ==================== //
+
+void TextIRBuilder::DeclFunc(const string& name, const vector<koopa_raw_type_t>& params, koopa_raw_type_t ret) {
+  out << "decl @" << name << "(";
+  for (size_t i = 0; i < params.size(); ++i) {
+    if (i) out << ", ";
+    out << type_name(params[i]);
+  }
+  out << ")";
+  if (ret->tag != KOOPA_RTT_UNIT)
+    out << ": " << type_name(ret);
+  out << '\n';
+}
+
+void TextIRBuilder::GlobalAlloc(const string& name, int init) {
+  out << "global " << name << " = alloc i32, ";
+  if (init)
+    out << init << '\n';
+  else
+    out << "zeroinit" << '\n';
+}
+
+void TextIRBuilder::EmitFuncBegin(const string& name, const vector<string>& params, bool is_void) {
+  out << "fun @" << name << "(";
+  for (size_t i = 0; i < params.size(); ++i) {
+    if (i) out << ", ";
+    out << "@" << params[i] << ": i32";
+  }
+  out << ")";
+  if (!is_void)
+    out << ": i32";
+  out << " {\n%entry_" << name << ":\n";
+}
+
+void TextIRBuilder::EmitFuncEnd() {
+  out << "}\n";
+}
+
+void TextIRBuilder::EmitLabel(const string& label) {
+  out << '\n' << label << ":\n";
+}
+
+void TextIRBuilder::EmitComment(const string& text) {
+  out << "  // " << text << '\n';
+}
+
+void TextIRBuilder::EmitAlloc(const string& dst) {
+  out << "  " << dst << " = alloc i32" << '\n';
+}
+
+void TextIRBuilder::EmitLoad(const string& dst, const string& src) {
+  out << "  " << dst << " = load " << src << '\n';
+}
+
+void TextIRBuilder::EmitStore(const string& val, const string& dst) {
+  out << "  store " << val << ", " << dst << '\n';
+}
+
+void TextIRBuilder::EmitBinary(koopa_raw_binary_op_t op, const string& dst, const string& lhs, const string& rhs) {
+  out << "  " << dst << " = " << binary_op_name(op) << " " << lhs << ", " << rhs << '\n';
+}
+
+void TextIRBuilder::EmitBranch(const string& cond, const string& label_true, const string& label_false) {
+  out << "  br " << cond << ", " << label_true << ", " << label_false << '\n';
+}
+
+void TextIRBuilder::EmitJump(const string& label) {
+  out << "  jump " << label << '\n';
+}
+
+void TextIRBuilder::EmitRet(const string& val) {
+  if (val.empty())
+    out << "  ret" << '\n';
+  else
+    out << "  ret " << val << '\n';
+}
+
+void TextIRBuilder::EmitCall(const string& dst, const string& func, const vector<string>& args) {
+  out << "  ";
+  if (!dst.empty())
+    out << dst << " = ";
+  out << "call @" << func << "(";
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (i) out << ", ";
+    out << args[i];
+  }
+  out << ")" << '\n';
+}
+
+// ==================== RawIRBuilder ==================== //
+
+const char* RawIRBuilder::NewName(const string& name) {
+  name_pool.push_back(name);
+  return name_pool.back().c_str();
+}
+
+koopa_raw_slice_t RawIRBuilder::NewSlice(vector<const void*> items, koopa_raw_slice_item_kind_t kind) {
+  koopa_raw_slice_t slice = {nullptr, 0, kind};
+  if (items.empty())
+    return slice;
+  slice_pool.push_back(move(items));
+  slice.buffer = slice_pool.back().data();
+  slice.len = slice_pool.back().size();
+  return slice;
+}
+
+/**
+ * @brief create a raw value with no users
+ *
+ * @param ty value type
+ * @param tag value kind
+ * @param name "%0" / "@x_1", empty for anonymous values
+ */
+RawIRBuilder::value_t* RawIRBuilder::NewValue(koopa_raw_type_t ty, koopa_raw_value_tag_t tag, const string& name) {
+  value_pool.emplace_back();
+  value_t *value = &value_pool.back();
+  value->ty = ty;
+  value->name = name.empty() ? nullptr : NewName(name);
+  value->used_by = NewSlice({}, KOOPA_RSIK_VALUE);
+  value->kind.tag = tag;
+  if (!name.empty())
+    value_map[name] = value;
+  return value;
+}
+
+koopa_raw_type_t RawIRBuilder::NewFuncType(const vector<koopa_raw_type_t>& params, koopa_raw_type_t ret) {
+  type_pool.emplace_back();
+  koopa_raw_type_kind_t &ty = type_pool.back();
+  ty.tag = KOOPA_RTT_FUNCTION;
+  ty.data.function.params = NewSlice(vector<const void*>(params.begin(), params.end()), KOOPA_RSIK_TYPE);
+  ty.data.function.ret = ret;
+  return &ty;
+}
+
+// functions may be referenced before defined, so create them on demand
+RawIRBuilder::func_t* RawIRBuilder::GetFunc(const string& name) {
+  auto it = func_map.find(name);
+  if (it != func_map.end())
+    return it->second;
+
+  func_pool.emplace_back();
+  func_t *func = &func_pool.back();
+  func->ty = nullptr;
+  func->name = NewName("@" + name);
+  func->params = NewSlice({}, KOOPA_RSIK_VALUE);
+  func->bbs = NewSlice({}, KOOPA_RSIK_BASIC_BLOCK);
+  func_map[name] = func;
+  funcs.push_back(func);
+  return func;
+}
+
+// labels may be referenced before placed, so create them on demand
+RawIRBuilder::bb_t* RawIRBuilder::GetBlock(const string& label) {
+  auto it = bb_map.find(label);
+  if (it != bb_map.end())
+    return it->second;
+
+  bb_pool.emplace_back();
+  bb_t *bb = &bb_pool.back();
+  bb->name = NewName(label);
+  bb->params = NewSlice({}, KOOPA_RSIK_VALUE);
+  bb->used_by = NewSlice({}, KOOPA_RSIK_VALUE);
+  bb->insts = NewSlice({}, KOOPA_RSIK_VALUE);
+  bb_map[label] = bb;
+  return bb;
+}
+
+koopa_raw_value_t RawIRBuilder::Operand(const string& repr) {
+  if (repr[0] == '%' || repr[0] == '@') {
+    auto it = value_map.find(repr);
+    if (it != value_map.end())
+      return it->second;
+    // global of the unit
+    assert(unit);
+    auto global = unit->value_map.find(repr);
+    assert(global != unit->value_map.end());
+    return global->second;
+  }
+  value_t *integer = NewValue(&type_i32, KOOPA_RVT_INTEGER);
+  integer->kind.data.integer.value = atoi(repr.c_str());
+  return integer;
+}
+
+void RawIRBuilder::Append(value_t *inst) {
+  assert(cur_func && !blocks.empty());
+  blocks.back().insts.push_back(inst);
+}
+
+koopa_raw_program_t RawIRBuilder::Build() {
+  MemScope mem(MEM_IR);
+  koopa_raw_program_t program;
+  program.values = NewSlice(globals, KOOPA_RSIK_VALUE);
+  program.funcs = NewSlice(funcs, KOOPA_RSIK_FUNCTION);
+  return program;
+}
+
+void RawIRBuilder::DeclFunc(const string& name, const vector<koopa_raw_type_t>& params, koopa_raw_type_t ret) {
+  MemScope mem(MEM_IR);
+  GetFunc(name)->ty = NewFuncType(params, ret);
+}
+
+void RawIRBuilder::GlobalAlloc(const string& name, int init) {
+  MemScope mem(MEM_IR);
+  value_t *init_value;
+  if (init) {
+    init_value = NewValue(&type_i32, KOOPA_RVT_INTEGER);
+    init_value->kind.data.integer.value = init;
+  } else {
+    init_value = NewValue(&type_i32, KOOPA_RVT_ZERO_INIT);
+  }
+
+  value_t *global = NewValue(&type_i32_ptr, KOOPA_RVT_GLOBAL_ALLOC, name);
+  global->kind.data.global_alloc.init = init_value;
+  globals.push_back(global);
+}
+
+void RawIRBuilder::EmitFuncBegin(const string& name, const vector<string>& params, bool is_void) {
+  vector<koopa_raw_type_t> param_types(params.size(), &type_i32);
+  DeclFunc(name, param_types, is_void ? &type_unit : &type_i32);
+
+  cur_func = GetFunc(name);
+  blocks.clear();
+  bb_map.clear();
+
+  vector<const void*> param_values;
+  for (size_t i = 0; i < params.size(); ++i) {
+    value_t *param = NewValue(&type_i32, KOOPA_RVT_FUNC_ARG_REF, "@" + params[i]);
+    param->kind.data.func_arg_ref.index = i;
+    param_values.push_back(param);
+  }
+  cur_func->params = NewSlice(param_values, KOOPA_RSIK_VALUE);
+
+  EmitLabel("%entry_" + name);
+}
+
+void RawIRBuilder::EmitFuncEnd() {
+  vector<const void*> bbs;
+  for (auto &block : blocks) {
+    block.bb->insts = NewSlice(move(block.insts), KOOPA_RSIK_VALUE);
+    bbs.push_back(block.bb);
+  }
+  cur_func->bbs = NewSlice(bbs, KOOPA_RSIK_BASIC_BLOCK);
+
+  cur_func = nullptr;
+  blocks.clear();
+  bb_map.clear();
+}
+
+void RawIRBuilder::EmitLabel(const string& label) {
+  blocks.push_back({GetBlock(label), {}});
+}
+
+void RawIRBuilder::EmitAlloc(const string& dst) {
+  Append(NewValue(&type_i32_ptr, KOOPA_RVT_ALLOC, dst));
+}
+
+void RawIRBuilder::EmitLoad(const string& dst, const string& src) {
+  koopa_raw_value_t src_value = Operand(src);
+  value_t *load = NewValue(&type_i32, KOOPA_RVT_LOAD, dst);
+  load->kind.data.load.src = src_value;
+  Append(load);
+}
+
+void RawIRBuilder::EmitStore(const string& val, const string& dst) {
+  value_t *store = NewValue(&type_unit, KOOPA_RVT_STORE);
+  store->kind.data.store.value = Operand(val);
+  store->kind.data.store.dest = Operand(dst);
+  Append(store);
+}
+
+void RawIRBuilder::EmitBinary(koopa_raw_binary_op_t op, const string& dst, const string& lhs, const string& rhs) {
+  koopa_raw_value_t lhs_value = Operand(lhs);
+  koopa_raw_value_t rhs_value = Operand(rhs);
+  value_t *binary = NewValue(&type_i32, KOOPA_RVT_BINARY, dst);
+  binary->kind.data.binary.op = op;
+  binary->kind.data.binary.lhs = lhs_value;
+  binary->kind.data.binary.rhs = rhs_value;
+  Append(binary);
+}
+
+void RawIRBuilder::EmitBranch(const string& cond, const string& label_true, const string& label_false) {
+  value_t *branch = NewValue(&type_unit, KOOPA_RVT_BRANCH);
+  branch->kind.data.branch.cond = Operand(cond);
+  branch->kind.data.branch.true_bb = GetBlock(label_true);
+  branch->kind.data.branch.false_bb = GetBlock(label_false);
+  branch->kind.data.branch.true_args = NewSlice({}, KOOPA_RSIK_VALUE);
+  branch->kind.data.branch.false_args = NewSlice({}, KOOPA_RSIK_VALUE);
+  Append(branch);
+}
+
+void RawIRBuilder::EmitJump(const string& label) {
+  value_t *jump = NewValue(&type_unit, KOOPA_RVT_JUMP);
+  jump->kind.data.jump.target = GetBlock(label);
+  jump->kind.data.jump.args = NewSlice({}, KOOPA_RSIK_VALUE);
+  Append(jump);
+}
+
+void RawIRBuilder::EmitRet(const string& val) {
+  value_t *ret = NewValue(&type_unit, KOOPA_RVT_RETURN);
+  ret->kind.data.ret.value = val.empty() ? nullptr : Operand(val);
+  Append(ret);
+}
+
+void RawIRBuilder::EmitCall(const string& dst, const string& func, const vector<string>& args) {
+  func_t *callee = GetFunc(func);
+  if (!callee->ty) {
+    // not declared in this builder, the call site tells its type
+    vector<koopa_raw_type_t> param_types(args.size(), &type_i32);
+    callee->ty = NewFuncType(param_types, dst.empty() ? &type_unit : &type_i32);
+  }
+
+  vector<const void*> arg_values;
+  for (auto &arg : args)
+    arg_values.push_back(Operand(arg));
+
+  value_t *call = NewValue(callee->ty->data.function.ret, KOOPA_RVT_CALL, dst);
+  call->kind.data.call.callee = callee;
+  call->kind.data.call.args = NewSlice(arg_values, KOOPA_RSIK_VALUE);
+  Append(call);
+}
@@ -0,0 +1,171 @@
+#ifndef BUILDER_H
+#define BUILDER_H
+
+#include <emitter.hpp>
+#include <koopa.h>
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+class IRBuilder;
+class TextIRBuilder;
+class RawIRBuilder;
+
+// shared raw types
+extern const koopa_raw_type_kind_t type_i32;
+extern const koopa_raw_type_kind_t type_unit;
+extern const koopa_raw_type_kind_t type_i32_ptr;
+
+// Koopa IR emission interface, the AST only talks to this.
+// Operands are Koopa style reprs: "%3", "@x_1" or an integer literal "5".
+// The builder tracks the current block: code after a br / jump / ret is
+// dropped up to the next label that some reachable code jumps to, and a
+// function that falls off its end gets a default ret.
+class IRBuilder {
+ private:
+  bool is_void = false;
+  bool reachable = false;   // current block has a reachable predecessor
+  bool terminated = false;  // current block already ends with br / jump / ret
+  unordered_set<string> targets;  // labels referenced by reachable code
+
+  bool Live() const { return reachable && !terminated; }
+
+ protected:
+  // called for reachable code only, every block gets exactly one terminator
+  virtual void EmitFuncBegin(const string& name, const vector<string>& params, bool is_void) = 0;  // opens %entry_<name>
+  virtual void EmitFuncEnd() = 0;
+  virtual void EmitLabel(const string& label) = 0;
+  virtual void EmitComment(const string& text) {}
+  virtual void EmitAlloc(const string& dst) = 0;
+  virtual void EmitLoad(const string& dst, const string& src) = 0;
+  virtual void EmitStore(const string& val, const string& dst) = 0;
+  virtual void EmitBinary(koopa_raw_binary_op_t op, const string& dst, const string& lhs, const string& rhs) = 0;
+  virtual void EmitBranch(const string& cond, const string& label_true, const string& label_false) = 0;
+  virtual void EmitJump(const string& label) = 0;
+  virtual void EmitRet(const string& val) = 0;
+  virtual void EmitCall(const string& dst, const string& func, const vector<string>& args) = 0;
+
+ public:
+  virtual ~IRBuilder() = default;
+
+  // program level
+  virtual void DeclFunc(const string& name, const vector<koopa_raw_type_t>& params, koopa_raw_type_t ret) = 0;
+  virtual void GlobalAlloc(const string& name, int init) = 0;
+  void FuncBegin(const string& name, const vector<string>& params, bool is_void);
+  void FuncEnd();
+
+  // function level
+  void Label(const string& label);
+  void Comment(const string& text);
+  void Alloc(const string& dst);
+  void Load(const string& dst, const string& src);
+  void Store(const string& val, const string& dst);
+  void Binary(koopa_raw_binary_op_t op, const string& dst, const string& lhs, const string& rhs);
+  void Branch(const string& cond, const string& label_true, const string& label_false);
+  void Jump(const string& label);
+  void Ret(const string& val);  // empty val means void return
+  void Call(const string& dst, const string& func, const vector<string>& args);  // empty dst means no result
+};
+
+// print Koopa text to an emitter (-koopa mode)
+class TextIRBuilder : public IRBuilder {
+ private:
+  Emitter &out;
+
+ protected:
+  virtual void EmitFuncBegin(const string& name, const vector<string>& params, bool is_void) override;
+  virtual void EmitFuncEnd() override;
+  virtual void EmitLabel(const string& label) override;
+  virtual void EmitComment(const string& text) override;
+  virtual void EmitAlloc(const string& dst) override;
+  virtual void EmitLoad(const string& dst, const string& src) override;
+  virtual void EmitStore(const string& val, const string& dst) override;
+  virtual void EmitBinary(koopa_raw_binary_op_t op, const string& dst, const string& lhs, const string& rhs) override;
+  virtual void EmitBranch(const string& cond, const string& label_true, const string& label_false) override;
+  virtual void EmitJump(const string& label) override;
+  virtual void EmitRet(const string& val) override;
+  virtual void EmitCall(const string& dst, const string& func, const vector<string>& args) override;
+
+ public:
+  TextIRBuilder(Emitter &out) : out(out) {}
+
+  virtual void DeclFunc(const string& name, const vector<koopa_raw_type_t>& params, koopa_raw_type_t ret) override;
+  virtual void GlobalAlloc(const string& name, int init) override;
+};
+
+// build koopa_raw_program_t in memory (-riscv mode), no text round trip
+// a function builder holds a single function, it looks up globals in the
+// builder of its unit and declares callees from their call sites
+class RawIRBuilder : public IRBuilder {
+  friend class Mem2Reg;  // adds values and blocks to the built functions
+
+ private:
+  typedef koopa_raw_value_data_t value_t;
+  typedef koopa_raw_basic_block_data_t bb_t;
+  typedef koopa_raw_function_data_t func_t;
+
+  // a basic block under construction
+  struct block_t {
+    bb_t *bb;
+    vector<const void*> insts;
+  };
+
+  // storage of everything referenced by the raw program
+  deque<value_t> value_pool;
+  deque<bb_t> bb_pool;
+  deque<func_t> func_pool;
+  deque<koopa_raw_type_kind_t> type_pool;
+  deque<vector<const void*>> slice_pool;
+  deque<string> name_pool;
+
+  vector<const void*> globals;
+  vector<const void*> funcs;
+  unordered_map<string, func_t*> func_map;
+  unordered_map<string, value_t*> value_map;
+
+  const RawIRBuilder *unit = nullptr;
+
+  // current function
+  func_t *cur_func = nullptr;
+  vector<block_t> blocks;
+  unordered_map<string, bb_t*> bb_map;
+
+  const char* NewName(const string& name);
+  koopa_raw_slice_t NewSlice(vector<const void*> items, koopa_raw_slice_item_kind_t kind);
+  value_t* NewValue(koopa_raw_type_t ty, koopa_raw_value_tag_t tag, const string& name = "");
+  koopa_raw_type_t NewFuncType(const vector<koopa_raw_type_t>& params, koopa_raw_type_t ret);
+  func_t* GetFunc(const string& name);
+  bb_t* GetBlock(const string& label);
+  koopa_raw_value_t Operand(const string& repr);
+  void Append(value_t *inst);
+
+ protected:
+  virtual void EmitFuncBegin(const string& name, const vector<string>& params, bool is_void) override;
+  virtual void EmitFuncEnd() override;
+  virtual void EmitLabel(const string& label) override;
+  virtual void EmitAlloc(const string& dst) override;
+  virtual void EmitLoad(const string& dst, const string& src) override;
+  virtual void EmitStore(const string& val, const string& dst) override;
+  virtual void EmitBinary(koopa_raw_binary_op_t op, const string& dst, const string& lhs, const string& rhs) override;
+  virtual void EmitBranch(const string& cond, const string& label_true, const string& label_false) override;
+  virtual void EmitJump(const string& label) override;
+  virtual void EmitRet(const string& val) override;
+  virtual void EmitCall(const string& dst, const string& func, const vector<string>& args) override;
+
+ public:
+  RawIRBuilder() = default;
+  explicit RawIRBuilder(const RawIRBuilder *unit) : unit(unit) {}
+
+  // finish building, the result lives as long as the builder
+  koopa_raw_program_t Build();
+
+  virtual void DeclFunc(const string& name, const vector<koopa_raw_type_t>& params, koopa_raw_type_t ret) override;
+  virtual void GlobalAlloc(const string& name, int init) override;
+};
+
+#endif
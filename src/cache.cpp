@@ -0,0 +1,202 @@
+#include <cache.hpp>
+
+#include <ast.hpp>
+#include <context.hpp>
+#include <lexer.hpp>
+#include <trace.hpp>
+#include "sysy.tab.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// bump when the layout of the store or of a key changes
+static const uint64_t CACHE_VERSION = 1;
+
+void Hasher::Add(string_view s) {
+  Add(s.size());
+  size_t i = 0;
+  for (; i + 8 <= s.size(); i += 8) {
+    uint64_t word;
+    memcpy(&word, s.data() + i, 8);
+    Add(word);
+  }
+  if (i < s.size()) {
+    uint64_t word = 0;
+    memcpy(&word, s.data() + i, s.size() - i);
+    Add(word);
+  }
+}
+
+uint32_t FuncCache::Check(const char *data, size_t len) {
+  Hasher hasher;
+  hasher.Add(string_view(data, len));
+  return hasher.Key().lo;
+}
+
+FuncCache::~FuncCache() {
+  if (entries)
+    munmap(reinterpret_cast<char*>(entries) - HEADER_SIZE, map_size);
+  if (index_fd >= 0)
+    close(index_fd);
+  if (data_fd >= 0)
+    close(data_fd);
+}
+
+/**
+ * @brief open (or create) the store in dir, a store of another format is
+ * started over
+ *
+ * @return bool whether the store can be used
+ */
+bool FuncCache::Open(const char *dir) {
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+    return false;
+  string path = dir;
+  index_fd = open((path + "/index").c_str(), O_RDWR | O_CREAT, 0644);
+  data_fd = open((path + "/data").c_str(), O_RDWR | O_CREAT, 0644);
+  if (index_fd < 0 || data_fd < 0)
+    return false;
+
+  // outputs of another compiler binary are never reused
+  struct stat exe;
+  if (stat("/proc/self/exe", &exe) == 0) {
+    Hasher hasher;
+    hasher.Add(CACHE_VERSION);
+    hasher.Add(exe.st_size);
+    hasher.Add(exe.st_mtim.tv_sec);
+    hasher.Add(exe.st_mtim.tv_nsec);
+    seed = hasher.Key().lo;
+  }
+
+  map_size = HEADER_SIZE + CAPACITY * sizeof(entry_t);
+  flock(index_fd, LOCK_EX);
+  header_t header = {0, 0};
+  bool fresh = pread(index_fd, &header, sizeof(header), 0) != sizeof(header) ||
+               header.magic != MAGIC || header.capacity != CAPACITY;
+  if (fresh) {
+    header = {MAGIC, CAPACITY};
+    bool ok = ftruncate(index_fd, 0) == 0 && ftruncate(index_fd, map_size) == 0 &&
+              ftruncate(data_fd, 0) == 0 &&
+              pwrite(index_fd, &header, sizeof(header), 0) == sizeof(header);
+    if (!ok) {
+      flock(index_fd, LOCK_UN);
+      return false;
+    }
+  }
+  flock(index_fd, LOCK_UN);
+
+  void *p = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, index_fd, 0);
+  if (p == MAP_FAILED)
+    return false;
+  entries = reinterpret_cast<entry_t*>(static_cast<char*>(p) + HEADER_SIZE);
+  TRACE(TRACE_CACHE, TRACE_INFO, "%s %s", dir, fresh ? "created" : "opened");
+  return true;
+}
+
+cache_key_t FuncCache::FuncKey(const char *mode, const FuncDefAST *func) const {
+  Hasher hasher;
+  hasher.Add(seed);
+  hasher.Add(string_view(mode));
+  hasher.Add(ctx->peephole ? ctx->peephole->Rules() : 0);
+  // local names are numbered on from the unit's scope count
+  hasher.Add(ctx->symtab_stack.count());
+
+  // the tokens, identifiers by name (ids depend on the order of interning)
+  vector<sym_id_t> idents;
+  vector<bool> seen(ctx->interner.size());
+  for (int i = func->first_token; i <= func->last_token; ++i) {
+    const token_t &token = ctx->tokens[i];
+    hasher.Add(token.kind);
+    if (token.kind == IDENT) {
+      sym_id_t id = token.value;
+      hasher.Add(ctx->interner.Name(id));
+      if (!seen[id]) {
+        seen[id] = true;
+        idents.push_back(id);
+      }
+    } else {
+      hasher.Add(static_cast<uint32_t>(token.value));
+    }
+  }
+
+  // what the identifiers mean in the unit: a global variable is reached by
+  // its name, a constant is folded, a call depends on the return type
+  for (sym_id_t id : idents) {
+    if (ctx->symtab_stack.Exist(id, false)) {
+      const sym_t &sym = ctx->symtab_stack.Lookup(id);
+      hasher.Add(sym.index());
+      if (holds_alternative<int>(sym))
+        hasher.Add(static_cast<uint32_t>(get<int>(sym)));
+      else
+        hasher.Add(get<string>(sym));
+    } else {
+      hasher.Add(~0ull);
+    }
+    hasher.Add(ctx->functab.Exist(id) ? static_cast<uint64_t>(ctx->functab.Lookup(id)) : ~0ull);
+  }
+
+  cache_key_t key = hasher.Key();
+  if (!key.lo)
+    key.lo = 1;  // 0 marks an empty entry
+  return key;
+}
+
+bool FuncCache::Lookup(const cache_key_t &key, string &out) {
+  for (size_t i = 0; entries && i < MAX_PROBE; ++i) {
+    entry_t &entry = entries[(key.lo + i) % CAPACITY];
+    uint64_t lo = __atomic_load_n(&entry.key_lo, __ATOMIC_ACQUIRE);
+    if (!lo)
+      break;
+    if (lo != key.lo || entry.key_hi != key.hi)
+      continue;
+    out.resize(entry.size);
+    if (pread(data_fd, &out[0], entry.size, entry.offset) == (ssize_t)entry.size &&
+        Check(out.data(), entry.size) == entry.check) {
+      hits++;
+      return true;
+    }
+    break;
+  }
+  misses++;
+  return false;
+}
+
+void FuncCache::Store(const cache_key_t &key, const char *data, size_t len) {
+  if (!entries || len > UINT32_MAX)
+    return;
+
+  // threads of this process, then other processes
+  lock_guard<mutex> guard(write_lock);
+  flock(index_fd, LOCK_EX);
+  for (size_t i = 0; i < MAX_PROBE; ++i) {
+    entry_t &entry = entries[(key.lo + i) % CAPACITY];
+    if (entry.key_lo == key.lo && entry.key_hi == key.hi)
+      break;
+    if (entry.key_lo)
+      continue;
+
+    off_t offset = lseek(data_fd, 0, SEEK_END);
+    if (offset < 0 || pwrite(data_fd, data, len, offset) != (ssize_t)len)
+      break;
+    entry.key_hi = key.hi;
+    entry.offset = offset;
+    entry.size = len;
+    entry.check = Check(data, len);
+    __atomic_store_n(&entry.key_lo, key.lo, __ATOMIC_RELEASE);
+    stores++;
+    break;
+  }
+  flock(index_fd, LOCK_UN);
+}
+
+void FuncCache::Report(FILE *out) const {
+  size_t total = hits + misses;
+  fprintf(out, "cache: %zu hits, %zu misses (%.1f%% hit), %zu stored\n", hits.load(), misses.load(),
+          total ? 100.0 * hits / total : 0.0, stores.load());
+}
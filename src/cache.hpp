@@ -0,0 +1,102 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+class FuncDefAST;
+
+// 128 bit content hash
+struct cache_key_t {
+  uint64_t lo;
+  uint64_t hi;
+};
+
+// two independently mixed 64 bit lanes over a stream of words
+class Hasher {
+ private:
+  uint64_t lo = 0x9e3779b97f4a7c15ull;
+  uint64_t hi = 0xc2b2ae3d27d4eb4full;
+
+  static uint64_t Mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+ public:
+  void Add(uint64_t word) {
+    lo = Mix(lo ^ word);
+    hi = Mix(hi + word * 0xff51afd7ed558ccdull);
+  }
+  void Add(string_view s);
+  cache_key_t Key() const { return {lo, hi}; }
+};
+
+// on-disk store of generated functions, addressed by the hash of
+// everything their output depends on (see FuncKey), shared by every
+// thread and by processes using the same directory
+//   <dir>/index: open addressing table of entries, mapped shared
+//   <dir>/data:  outputs, appended
+// writers hold a file lock, readers only map the index
+class FuncCache {
+ private:
+  static const uint64_t MAGIC = 0x3165686361637973ull;  // "sycache1"
+  static const size_t CAPACITY = 1 << 16;                // entries
+  static const size_t MAX_PROBE = 32;
+  static const size_t HEADER_SIZE = 64;
+
+  struct entry_t {
+    uint64_t key_lo;  // 0: empty, written last
+    uint64_t key_hi;
+    uint64_t offset;  // in the data file
+    uint32_t size;
+    uint32_t check;   // hash of the data, catches torn appends
+  };
+
+  struct header_t {
+    uint64_t magic;
+    uint64_t capacity;
+  };
+
+  int index_fd = -1;
+  int data_fd = -1;
+  entry_t *entries = nullptr;
+  size_t map_size = 0;
+  uint64_t seed = 0;  // identity of the compiler binary
+  mutex write_lock;
+
+  atomic<size_t> hits{0};
+  atomic<size_t> misses{0};
+  atomic<size_t> stores{0};
+
+  static uint32_t Check(const char *data, size_t len);
+
+ public:
+  FuncCache() = default;
+  FuncCache(const FuncCache&) = delete;
+  FuncCache& operator=(const FuncCache&) = delete;
+  ~FuncCache();
+
+  bool Open(const char *dir);
+
+  // everything the output of func in mode depends on: its own tokens, and
+  // what its identifiers are bound to in the unit (global variable names,
+  // constant values, function return types), and the peephole rules
+  cache_key_t FuncKey(const char *mode, const FuncDefAST *func) const;
+
+  bool Lookup(const cache_key_t &key, string &out);
+  void Store(const cache_key_t &key, const char *data, size_t len);
+
+  void Report(FILE *out) const;
+};
+
+#endif
@@ -1,51 +1,445 @@
 #include <ast.hpp>
+#include <cache.hpp>
+#include <context.hpp>
+#include <elf.hpp>
 #include <ir.hpp>
+#include <lexer.hpp>
+#include <mem2reg.hpp>
+#include <memstat.hpp>
+#include <peephole.hpp>
+#include <pool.hpp>
+#include <server.hpp>
+#include <timeline.hpp>
+#include <trace.hpp>
 
+#include <atomic>
 #include <cassert>
 #include <cstdio>
-#include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <sstream>
+#include <utility>
+#include <vector>
+#include <unistd.h>
 
 using namespace std;
 
 
-extern FILE *yyin;
-extern int yyparse(unique_ptr<BaseAST> &ast);
+// reentrant parser (sysy.y)
+extern int yyparse(Lexer *lexer, BaseAST *&ast);
+
+// command line options shared by all compilations
+struct options_t {
+  bool use_mmap = false;             // write the output file through a shared mapping
+  bool use_flex = false;             // lex with the flex scanner instead of the fast one
+  bool time_report = false;          // print the time of every phase at exit
+  bool mem_report = false;           // print allocations per subsystem and RSS per phase at exit
+  const char *trace_file = nullptr;  // write the timed phases as Chrome trace events
+  const char *cache_dir = nullptr;   // reuse functions generated by earlier runs
+  int jobs = 0;                      // threads, 0 means one per core
+  uint32_t peephole = Peephole::ALL; // peephole rules applied to the generated machine code
+  bool peephole_report = false;      // print the rewrites of every peephole rule at exit
+};
+
+// process-wide services handed to every compilation, each may be null
+struct shared_t {
+  ThreadPool *pool = nullptr;    // runs batch files and functions in parallel
+  FuncCache *cache = nullptr;    // generated functions of earlier runs
+  Timeline *timeline = nullptr;  // times the phases
+  Peephole *peephole = nullptr;  // cleans up generated machine code
+};
+
+/**
+ * @brief lower (and generate) every function as a task of its own
+ * each task works in a function context and writes into that context's
+ * emitter, the buffers are appended in source order, so the output does
+ * not depend on the number of threads
+ * functions found in the cache are not generated again, new ones are stored
+ *
+ * @param mode "-koopa", "-riscv" or "-obj"
+ * @param unit parsed compile unit, its Dump() is done
+ * @param unit_builder builder of the unit in -riscv / -obj mode, null in -koopa mode
+ */
+static void DumpFuncs(const char *mode, CompUnitAST *unit, const RawIRBuilder *unit_builder) {
+  Context &context = *ctx;
+  FuncCache *cache = context.cache;
+  auto &funcs = unit->func_def_list;
+  vector<unique_ptr<Context>> func_ctxs(funcs.size());
+  vector<cache_key_t> keys(funcs.size());
+  vector<string> cached(funcs.size());
+  vector<bool> hit(funcs.size());
+
+  vector<function<void()>> tasks;
+  if (cache) {
+    TimeScope time(context.timeline, "cache");
+    MemScope mem(MEM_CACHE);
+    for (size_t i = 0; i < funcs.size(); ++i) {
+      keys[i] = cache->FuncKey(mode, funcs[i]->As<FuncDefAST>());
+      hit[i] = cache->Lookup(keys[i], cached[i]);
+    }
+  }
+  for (size_t i = 0; i < funcs.size(); ++i) {
+    if (hit[i])
+      continue;
+    tasks.push_back([&, i] {
+      MemScope mem(MEM_LOWER);
+      func_ctxs[i] = make_unique<Context>(&context);
+      ContextScope scope(func_ctxs[i].get());
+      string name;
+      if (ctx->timeline)
+        name = ctx->interner.Name(funcs[i]->As<FuncDefAST>()->ident);
+      if (unit_builder) {
+        RawIRBuilder builder(unit_builder);
+        ctx->ir_builder = &builder;
+        {
+          TimeScope time(ctx->timeline, "lower", name);
+          funcs[i]->Dump();
+        }
+        if (!ctx->error) {
+          koopa_raw_program_t raw;
+          {
+            TimeScope time(ctx->timeline, "build raw", name);
+            raw = builder.Build();
+          }
+          {
+            TimeScope time(ctx->timeline, "mem2reg", name);
+            Mem2Reg(builder).Run(raw);
+          }
+          TimeScope time(ctx->timeline, "riscv", name);
+          MemScope mem(MEM_BACKEND);
+          gen_riscv(raw);
+        }
+      } else {
+        TextIRBuilder builder(ctx->emitter);
+        ctx->ir_builder = &builder;
+        TimeScope time(ctx->timeline, "lower", name);
+        funcs[i]->Dump();
+      }
+      ctx->ir_builder = nullptr;
+      if (cache && !ctx->error) {
+        MemScope mem(MEM_CACHE);
+        cache->Store(keys[i], ctx->emitter.data(), ctx->emitter.size());
+      }
+    });
+  }
+  if (context.pool)
+    context.pool->Run(tasks);
+  else
+    for (auto &task : tasks)
+      task();
+
+  TimeScope time(context.timeline, "write");
+  for (size_t i = 0; i < funcs.size(); ++i) {
+    if (hit[i]) {
+      context.emitter << cached[i];
+    } else {
+      context.emitter.Write(func_ctxs[i]->emitter.data(), func_ctxs[i]->emitter.size());
+      if (func_ctxs[i]->error)
+        context.error = true;
+      func_ctxs[i].reset();
+    }
+  }
+}
+
+/**
+ * @brief compile a source held in memory into ctx->emitter
+ * (object fragments in -obj mode, see WriteElf)
+ *
+ * @param mode "-koopa", "-riscv" or "-obj"
+ * @param name input file or server request, for the reports
+ * @param src source text
+ * @param len source length
+ * @param opts command line options
+ * @return bool false on a syntax or semantic error
+ */
+static bool CompileSource(const char *mode, const char *name, const char *src, size_t len,
+                          const options_t &opts) {
+  Context &context = *ctx;
+  BaseAST *ast = nullptr;
+  {
+    TimeScope time(context.timeline, "parse");
+    MemScope mem(MEM_PARSE);
+    Lexer lexer(src, len, opts.use_flex, context.cache ? &context.tokens : nullptr);
+    if (yyparse(&lexer, ast))
+      return false;
+  }
+  MemSample("parse");
+
+  auto unit = ast->As<CompUnitAST>();
+  if (string(mode) == "-koopa") {
+    // dump AST as koopa text
+    TextIRBuilder builder(context.emitter);
+    context.ir_builder = &builder;
+    {
+      TimeScope time(context.timeline, "lower", "<globals>");
+      MemScope mem(MEM_LOWER);
+      unit->Dump();
+    }
+    MemSample("globals");
+    DumpFuncs(mode, unit, nullptr);
+  } else if (string(mode) == "-riscv" || string(mode) == "-obj") {
+    // lower AST straight into raw programs: the unit's globals, then one per function
+    context.obj = string(mode) == "-obj";
+    RawIRBuilder builder;
+    context.ir_builder = &builder;
+    {
+      TimeScope time(context.timeline, "lower", "<globals>");
+      MemScope mem(MEM_LOWER);
+      unit->Dump();
+    }
+    koopa_raw_program_t raw;
+    {
+      TimeScope time(context.timeline, "build raw", "<globals>");
+      raw = builder.Build();
+    }
+    {
+      TimeScope time(context.timeline, "riscv", "<globals>");
+      MemScope mem(MEM_BACKEND);
+      gen_riscv(raw);
+    }
+    MemSample("globals");
+    DumpFuncs(mode, unit, &builder);
+  }
+  context.ir_builder = nullptr;
+  MemSample("functions");
+
+  // the whole AST goes away at once
+  MemArena(name, context.ast_arena.nodes(), context.ast_arena.bytes(), context.ast_arena.chunk_num());
+  context.ast_arena.Release();
+  MemSample("release");
+  return !context.error;
+}
+
+/**
+ * @brief compile one source file, all state lives in a fresh Context
+ * so any number of these may run at the same time
+ *
+ * @param mode "-koopa", "-riscv" or "-obj"
+ * @param input source file
+ * @param output output file
+ * @param opts command line options
+ * @param shared pool, cache and timeline of the process
+ * @return bool false if the input is not read, the output not opened or
+ * the source not compiled, reported on stderr; no output file is left
+ */
+static bool Compile(const char *mode, const char *input, const char *output, const options_t &opts,
+                    const shared_t &shared) {
+  Context context;
+  ContextScope scope(&context);
+  context.pool = shared.pool;
+  context.cache = shared.cache;
+  context.timeline = shared.timeline;
+  context.peephole = shared.peephole;
+  TimeScope time(context.timeline, "compile", input);
+
+  // the source is lexed straight from its mapping
+  MappedFile in;
+  if (!in.Open(input)) {
+    fprintf(stderr, "error: %s: cannot read\n", input);
+    return false;
+  }
+  // -obj: the fragments stay in memory until they are linked into the file
+  Emitter obj_file;
+  Emitter &file = strcmp(mode, "-obj") ? context.emitter : obj_file;
+  if (!file.Open(output, opts.use_mmap)) {
+    fprintf(stderr, "error: %s: cannot open %s\n", input, output);
+    return false;
+  }
+
+  if (!CompileSource(mode, input, in.data(), in.size(), opts)) {
+    // the output is written as it is generated, drop what is there
+    file.Close();
+    unlink(output);
+    fprintf(stderr, "error: %s: not compiled\n", input);
+    return false;
+  }
+  {
+    TimeScope write(context.timeline, "write", input);
+    if (context.obj)
+      WriteElf(context.emitter.data(), context.emitter.size(), file);
+    file.Close();
+  }
+  MemSample("write");
+  return true;
+}
+
+/**
+ * @brief compile every "<input> <output>" line of the list file on a
+ * work-stealing pool, a file that fails does not stop the others
+ *
+ * @return bool false if the list is not read or any file failed
+ */
+static bool CompileBatch(const char *mode, const char *list, const options_t &opts,
+                         const shared_t &shared) {
+  ifstream fin(list);
+  if (!fin) {
+    fprintf(stderr, "error: %s: cannot read\n", list);
+    return false;
+  }
+  vector<pair<string, string>> files;
+  string input, output;
+  while (fin >> input >> output)
+    files.emplace_back(input, output);
+
+  TRACE(TRACE_BATCH, TRACE_INFO, "%zu files on %d threads", files.size(), shared.pool->size());
+  atomic<size_t> failed{0};
+  vector<function<void()>> tasks;
+  for (auto &file : files)
+    tasks.push_back([&file, &opts, &shared, &failed, mode] {
+      if (!Compile(mode, file.first.c_str(), file.second.c_str(), opts, shared))
+        failed.fetch_add(1, memory_order_relaxed);
+    });
+  shared.pool->Run(tasks);
+  if (failed)
+    fprintf(stderr, "error: %zu of %zu files not compiled\n", failed.load(), files.size());
+  return !failed;
+}
+
+/**
+ * @brief serve compile requests on a unix domain socket until killed,
+ * see server.hpp for the protocol
+ * the process never gets to its reports: every request is timed on a
+ * timeline of its own, and -time-report / -mem-report are printed after
+ * each request instead (the memory of the process so far)
+ */
+static void Serve(const char *socket_path, const options_t &opts, const shared_t &shared) {
+  atomic<size_t> request_cnt{0};
+  mutex report_lock;  // reports of concurrent requests do not interleave
+  CompileServer server([&](const char *mode, const char *src, size_t len, Emitter &out) {
+    if (strcmp(mode, "-koopa") && strcmp(mode, "-riscv") && strcmp(mode, "-obj"))
+      return false;
+    size_t request = ++request_cnt;
+    string name = "request " + to_string(request);
+    Timeline timeline;
+    Context context;
+    ContextScope scope(&context);
+    context.pool = shared.pool;
+    context.cache = shared.cache;
+    context.timeline = opts.time_report ? &timeline : nullptr;
+    context.peephole = shared.peephole;
+    bool compiled;
+    {
+      TimeScope time(context.timeline, "compile", mode);
+      compiled = CompileSource(mode, name.c_str(), src, len, opts);
+      if (compiled) {
+        TimeScope write(context.timeline, "write", mode);
+        if (context.obj)
+          WriteElf(context.emitter.data(), context.emitter.size(), out);
+        else
+          out.Write(context.emitter.data(), context.emitter.size());
+      }
+    }
+    if (opts.time_report || opts.mem_report) {
+      lock_guard<mutex> guard(report_lock);
+      fprintf(stderr, "%s: %s, %s\n", name.c_str(), mode, compiled ? "compiled" : "not compiled");
+      if (opts.time_report)
+        timeline.Report(stderr);
+      if (opts.mem_report)
+        MemReport(stderr);
+    }
+    return compiled;
+  });
+  bool listening = server.Listen(socket_path);
+  assert(listening);
+  server.Run(shared.pool->size());
+}
 
 int main(int argc, const char *argv[]) {
-  assert(argc == 5);
+  // compiler <mode> <input> -o <output> [options]
+  //   mode: -koopa (koopa text), -riscv (assembly), -obj (ELF relocatable object)
+  // compiler <mode> -batch <list> [options]
+  // compiler -server <socket> [options]
+  // exits with 1 if a file is not compiled (the others of a batch still are)
+  assert(argc >= 3);
+  TraceInit();
   auto mode = argv[1];
-  auto input = argv[2];
-  auto output = argv[4];
-  
-  yyin = fopen(input, "r");
-  ofstream fout(output);
-  assert(yyin && fout);
-
-  unique_ptr<BaseAST> ast;
-  auto ret = yyparse(ast);
-  assert(!ret);
-
-  streambuf *oldcout = cout.rdbuf(fout.rdbuf());
-  if (std::string(mode) == "-koopa") {
-    // dump AST
-    // cout << "// gen koopa" << endl;
-    ast->Dump();
-  } else if (std::string(mode) == "-riscv") {
-    // get koopa str
-    stringstream ss;
-    cout.rdbuf(ss.rdbuf());
-    ast->Dump();
-    cout.rdbuf(fout.rdbuf());
-  
-    // cout << "# gen riscv" << endl;
-    gen_riscv(ss.str());
-  }
-  cout.rdbuf(oldcout);
-  fout.close();
-  
-  return 0;
-}
\ No newline at end of file
+  bool server = !strcmp(mode, "-server");
+  bool batch = !server && argc >= 4 && !strcmp(argv[2], "-batch");
+  assert(server || batch || (argc >= 5 && !strcmp(argv[3], "-o")));
+
+  // -mmap: write the output file through a shared mapping
+  // -flex: lex with the flex scanner (reference of the fast one)
+  // -j <n>: threads (default: one per core)
+  // -cache <dir>: reuse functions generated by earlier runs, report hits on stderr
+  // -time-report: print the time of every phase on stderr (of every request with -server)
+  // -trace <file>: write the timed phases as Chrome trace events (not with -server)
+  // -mem-report: print allocations per subsystem, the resident set per phase and the
+  //              AST arenas on stderr (after every request with -server)
+  // -peephole <rules>: all (default), none, or some of forward,dead-store,li,mv,branch,cmp
+  // -peephole-report: print the rewrites of every peephole rule on stderr
+  options_t opts;
+  for (int i = server ? 3 : batch ? 4 : 5; i < argc; ++i) {
+    if (!strcmp(argv[i], "-mmap"))
+      opts.use_mmap = true;
+    else if (!strcmp(argv[i], "-flex"))
+      opts.use_flex = true;
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      opts.jobs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-cache") && i + 1 < argc)
+      opts.cache_dir = argv[++i];
+    else if (!strcmp(argv[i], "-time-report"))
+      opts.time_report = true;
+    else if (!strcmp(argv[i], "-trace") && i + 1 < argc)
+      opts.trace_file = argv[++i];
+    else if (!strcmp(argv[i], "-mem-report"))
+      opts.mem_report = true;
+    else if (!strcmp(argv[i], "-peephole") && i + 1 < argc) {
+      bool parsed = Peephole::ParseRules(argv[++i], opts.peephole);
+      assert(parsed);
+    } else if (!strcmp(argv[i], "-peephole-report"))
+      opts.peephole_report = true;
+    else
+      assert(false);
+  }
+
+  if (server && opts.trace_file) {
+    fprintf(stderr, "error: -trace is written at exit, a server does not exit\n");
+    return 1;
+  }
+  mem_accounting = opts.mem_report;
+
+  // files of a batch and functions of a file share the pool,
+  // the server runs one connection per thread on it
+  ThreadPool pool(opts.jobs);
+  unique_ptr<FuncCache> cache;
+  if (opts.cache_dir) {
+    cache = make_unique<FuncCache>();
+    bool opened = cache->Open(opts.cache_dir);
+    assert(opened);
+  }
+  // the server times every request on its own timeline, see Serve()
+  unique_ptr<Timeline> timeline;
+  if (!server && (opts.time_report || opts.trace_file))
+    timeline = make_unique<Timeline>();
+  Peephole peephole(opts.peephole);
+
+  shared_t shared;
+  shared.pool = &pool;
+  shared.cache = cache.get();
+  shared.timeline = timeline.get();
+  shared.peephole = opts.peephole ? &peephole : nullptr;
+  bool ok = true;
+  if (server)
+    Serve(argv[2], opts, shared);
+  else if (batch)
+    ok = CompileBatch(mode, argv[3], opts, shared);
+  else
+    ok = Compile(mode, argv[2], argv[4], opts, shared);
+  if (cache)
+    cache->Report(stderr);
+  if (opts.peephole_report)
+    peephole.Report(stderr);
+  if (timeline && opts.time_report)
+    timeline->Report(stderr);
+  if (opts.mem_report)
+    MemReport(stderr);
+  if (opts.trace_file) {
+    bool written = timeline->WriteTrace(opts.trace_file);
+    assert(written);
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,3 @@
+#include <context.hpp>
+
+thread_local Context *ctx = nullptr;
@@ -0,0 +1,84 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <arena.hpp>
+#include <builder.hpp>
+#include <emitter.hpp>
+#include <exp.hpp>
+#include <global.hpp>
+#include <ir.hpp>
+#include <lexer.hpp>
+#include <peephole.hpp>
+#include <pool.hpp>
+#include <regalloc.hpp>
+#include <timeline.hpp>
+
+class FuncCache;
+
+class Context;
+class ContextScope;
+extern thread_local Context *ctx;  // context of the compilation running on this thread
+
+// all state of one compilation (source file -> output file)
+// nothing per-compile lives in globals, so compilations can run side by
+// side on different threads, each one installs its own context in ctx
+//
+// every function is lowered in a function context of its own, which
+// borrows the read-only tables of the unit and starts from its global
+// scope, so functions can be generated in parallel and still get the
+// same names as in a serial run
+class Context {
+ private:
+  Interner own_interner;
+  FuncTab own_functab;
+  ExpPool own_exps;
+
+ public:
+  // frontend
+  Interner &interner;  // shared with function contexts
+  FuncTab &functab;    // shared with function contexts
+  ExpPool &exps;       // all expressions, shared, a function writes only its own nodes
+  Arena ast_arena;     // owns the AST
+  vector<token_t> tokens;  // all tokens of the source, recorded for the cache only
+  SymTabStack symtab_stack;
+  WhileStack while_stack;  // to maintain multi while
+  int label_cnt = 0;
+  int tmp_var_no = 0;  // current temp variable number
+  bool error = false;  // a semantic error was reported, the output is not valid
+
+  // output
+  IRBuilder *ir_builder = nullptr;  // where AST Dump sends the generated IR
+  Emitter emitter;
+  ThreadPool *pool = nullptr;  // runs the function tasks, serial if null
+  FuncCache *cache = nullptr;  // generated functions of earlier runs, none if null
+  Timeline *timeline = nullptr;  // where phases are timed, untimed if null
+  Peephole *peephole = nullptr;  // rewrites the machine code of functions, none if null
+  bool obj = false;  // -obj: the backend writes object fragments (elf.hpp), not assembly
+
+  // riscv backend, reset for every function
+  ValueMap vmap;
+  RegAlloc reg_alloc;
+  MirFunc mir;  // machine code of the function
+
+  Context() : interner(own_interner), functab(own_functab), exps(own_exps) {}
+  // function context of unit
+  explicit Context(Context *unit)
+      : interner(unit->interner), functab(unit->functab), exps(unit->exps),
+        symtab_stack(unit->symtab_stack), pool(unit->pool), timeline(unit->timeline),
+        peephole(unit->peephole), obj(unit->obj) {}
+  Context(const Context&) = delete;
+  Context& operator=(const Context&) = delete;
+};
+
+// install a context on this thread, the previous one comes back on exit
+// (a thread waiting for its tasks runs other tasks in between)
+class ContextScope {
+ private:
+  Context *saved;
+
+ public:
+  explicit ContextScope(Context *context) : saved(ctx) { ctx = context; }
+  ~ContextScope() { ctx = saved; }
+};
+
+#endif
@@ -0,0 +1,390 @@
+#include <elf.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+// x register of every reg id
+const uint32_t reg_x[] = {
+  5, 6, 7, 28, 29, 30, 31,
+  10, 11, 12, 13, 14, 15, 16, 17,
+  0, 2, 1,
+};
+
+enum : uint32_t {
+  OPC_OP = 0x33,
+  OPC_OP_IMM = 0x13,
+  OPC_LOAD = 0x03,
+  OPC_STORE = 0x23,
+  OPC_BRANCH = 0x63,
+  OPC_JAL = 0x6f,
+  OPC_JALR = 0x67,
+  OPC_LUI = 0x37,
+  OPC_AUIPC = 0x17,
+};
+
+const uint32_t R_RISCV_CALL_PLT = 19;
+
+uint32_t X(int reg) {
+  assert(reg >= 0 && reg <= REG_RA);
+  return reg_x[reg];
+}
+
+bool Fits(int32_t value, int bits) {
+  return value >= -(1 << (bits - 1)) && value < (1 << (bits - 1));
+}
+
+uint32_t EncR(uint32_t funct7, uint32_t funct3, int rd, int rs1, int rs2) {
+  return funct7 << 25 | X(rs2) << 20 | X(rs1) << 15 | funct3 << 12 | X(rd) << 7 | OPC_OP;
+}
+
+uint32_t EncI(uint32_t opcode, uint32_t funct3, int rd, int rs1, int32_t imm) {
+  return (uint32_t)imm << 20 | X(rs1) << 15 | funct3 << 12 | X(rd) << 7 | opcode;
+}
+
+uint32_t EncS(int rs2, int rs1, int32_t imm) {
+  uint32_t u = imm;
+  return (u >> 5 & 0x7f) << 25 | X(rs2) << 20 | X(rs1) << 15 | 2 << 12 | (u & 0x1f) << 7 | OPC_STORE;
+}
+
+// beq / bne rs1, x0
+uint32_t EncB(uint32_t funct3, int rs1, int32_t offset) {
+  uint32_t u = offset;
+  return (u >> 12 & 1) << 31 | (u >> 5 & 0x3f) << 25 | X(REG_X0) << 20 | X(rs1) << 15 |
+         funct3 << 12 | (u >> 1 & 0xf) << 8 | (u >> 11 & 1) << 7 | OPC_BRANCH;
+}
+
+uint32_t EncJ(int rd, int32_t offset) {
+  uint32_t u = offset;
+  return (u >> 20 & 1) << 31 | (u >> 1 & 0x3ff) << 21 | (u >> 11 & 1) << 20 |
+         (u >> 12 & 0xff) << 12 | X(rd) << 7 | OPC_JAL;
+}
+
+uint32_t EncU(uint32_t opcode, int rd, uint32_t hi20) {
+  return hi20 << 12 | X(rd) << 7 | opcode;
+}
+
+// imm = hi20 << 12 + lo12, lo12 sign extended
+int32_t Lo12(int32_t imm) {
+  return (int32_t)((uint32_t)imm << 20) >> 20;
+}
+
+uint32_t Hi20(int32_t imm) {
+  return ((uint32_t)imm - (uint32_t)Lo12(imm)) >> 12;
+}
+
+// words an instruction expands to
+int Words(const mir_inst_t &inst, bool far) {
+  switch (inst.op) {
+    case MIR_LI:
+      // addi, lui, or both
+      return Lo12(inst.imm) == inst.imm || Lo12(inst.imm) == 0 ? 1 : 2;
+    case MIR_BNEZ:
+    case MIR_BEQZ:
+      return far ? 2 : 1;
+    case MIR_CALL:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
+template <typename T>
+void Put(Emitter &out, T value) {
+  char bytes[sizeof(T)];
+  for (size_t i = 0; i < sizeof(T); ++i)
+    bytes[i] = (char)((uint64_t)value >> (8 * i));
+  out.Write(bytes, sizeof(T));
+}
+
+void PutName(Emitter &out, string_view name) {
+  Put<uint32_t>(out, name.size());
+  out.Write(name.data(), name.size());
+}
+
+// reads back what EncodeFunc wrote
+class FragReader {
+ private:
+  const char *p;
+  const char *end;
+
+ public:
+  FragReader(const char *data, size_t len) : p(data), end(data + len) {}
+  bool Done() const { return p == end; }
+  uint32_t Word() {
+    assert(end - p >= 4);
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+      value |= (uint32_t)(uint8_t)p[i] << (8 * i);
+    p += 4;
+    return value;
+  }
+  string_view Bytes(size_t len) {
+    assert((size_t)(end - p) >= len);
+    string_view bytes(p, len);
+    p += len;
+    return bytes;
+  }
+  string_view Name() { return Bytes(Word()); }
+};
+}  // namespace
+
+/**
+ * @brief encode a finalized function into a fragment, see elf.hpp
+ */
+void EncodeFunc(const MirFunc &func, Emitter &out) {
+  // lay out: a branch out of reach takes two words and moves the code
+  // after it, so repeat until no more branches grow
+  vector<int32_t> block_at(func.blocks.size());
+  vector<pair<int32_t, int>> branches;  // (offset, target block) of every bnez / beqz
+  vector<bool> far;                     // of every bnez / beqz
+  for (bool grown = true; grown;) {
+    int32_t at = 0;
+    branches.clear();
+    for (size_t b = 0; b < func.blocks.size(); ++b) {
+      block_at[b] = at;
+      for (auto &inst : func.blocks[b].insts) {
+        bool branch = inst.op == MIR_BNEZ || inst.op == MIR_BEQZ;
+        if (branch) {
+          branches.push_back({at, inst.imm});
+          if (far.size() < branches.size())
+            far.push_back(false);
+        }
+        at += 4 * Words(inst, branch && far[branches.size() - 1]);
+      }
+    }
+    grown = false;
+    for (size_t k = 0; k < branches.size(); ++k) {
+      if (!far[k] && !Fits(block_at[branches[k].second] - branches[k].first, 13))
+        far[k] = grown = true;
+    }
+  }
+
+  vector<uint32_t> code;
+  vector<pair<int32_t, int>> calls;  // (offset, callee in syms)
+  size_t k = 0;
+  for (auto &block : func.blocks) {
+    for (auto &inst : block.insts) {
+      int32_t at = code.size() * 4;
+      switch (inst.op) {
+        case MIR_ADD: code.push_back(EncR(0x00, 0, inst.rd, inst.rs1, inst.rs2)); break;
+        case MIR_SUB: code.push_back(EncR(0x20, 0, inst.rd, inst.rs1, inst.rs2)); break;
+        case MIR_MUL: code.push_back(EncR(0x01, 0, inst.rd, inst.rs1, inst.rs2)); break;
+        case MIR_DIV: code.push_back(EncR(0x01, 4, inst.rd, inst.rs1, inst.rs2)); break;
+        case MIR_REM: code.push_back(EncR(0x01, 6, inst.rd, inst.rs1, inst.rs2)); break;
+        case MIR_SLT: code.push_back(EncR(0x00, 2, inst.rd, inst.rs1, inst.rs2)); break;
+        case MIR_SGT: code.push_back(EncR(0x00, 2, inst.rd, inst.rs2, inst.rs1)); break;  // slt swapped
+        case MIR_AND: code.push_back(EncR(0x00, 7, inst.rd, inst.rs1, inst.rs2)); break;
+        case MIR_OR: code.push_back(EncR(0x00, 6, inst.rd, inst.rs1, inst.rs2)); break;
+        case MIR_XOR: code.push_back(EncR(0x00, 4, inst.rd, inst.rs1, inst.rs2)); break;
+        case MIR_ADDI: code.push_back(EncI(OPC_OP_IMM, 0, inst.rd, inst.rs1, inst.imm)); break;
+        case MIR_XORI: code.push_back(EncI(OPC_OP_IMM, 4, inst.rd, inst.rs1, inst.imm)); break;
+        case MIR_SEQZ: code.push_back(EncI(OPC_OP_IMM, 3, inst.rd, inst.rs1, 1)); break;  // sltiu rd, rs, 1
+        case MIR_SNEZ: code.push_back(EncR(0x00, 3, inst.rd, REG_X0, inst.rs1)); break;   // sltu rd, x0, rs
+        case MIR_MV: code.push_back(EncI(OPC_OP_IMM, 0, inst.rd, inst.rs1, 0)); break;
+        case MIR_LI:
+          if (Lo12(inst.imm) == inst.imm) {
+            code.push_back(EncI(OPC_OP_IMM, 0, inst.rd, REG_X0, inst.imm));
+          } else {
+            code.push_back(EncU(OPC_LUI, inst.rd, Hi20(inst.imm)));
+            if (Lo12(inst.imm))
+              code.push_back(EncI(OPC_OP_IMM, 0, inst.rd, inst.rd, Lo12(inst.imm)));
+          }
+          break;
+        case MIR_LW: code.push_back(EncI(OPC_LOAD, 2, inst.rd, inst.rs1, inst.imm)); break;
+        case MIR_SW: code.push_back(EncS(inst.rs2, inst.rs1, inst.imm)); break;
+        case MIR_BNEZ:
+        case MIR_BEQZ: {
+          uint32_t funct3 = inst.op == MIR_BNEZ ? 1 : 0;  // bne / beq
+          if (far[k]) {
+            // the inverse branch over a jal
+            int32_t offset = block_at[inst.imm] - (at + 4);
+            assert(Fits(offset, 21));
+            code.push_back(EncB(funct3 ^ 1, inst.rs1, 8));
+            code.push_back(EncJ(REG_X0, offset));
+          } else {
+            code.push_back(EncB(funct3, inst.rs1, block_at[inst.imm] - at));
+          }
+          k++;
+          break;
+        }
+        case MIR_J: {
+          int32_t offset = block_at[inst.imm] - at;
+          assert(Fits(offset, 21));
+          code.push_back(EncJ(REG_X0, offset));
+          break;
+        }
+        case MIR_CALL:
+          // auipc ra, 0; jalr ra, 0(ra), filled by the linker
+          calls.push_back({at, inst.imm});
+          code.push_back(EncU(OPC_AUIPC, REG_RA, 0));
+          code.push_back(EncI(OPC_JALR, 0, REG_RA, REG_RA, 0));
+          break;
+        case MIR_RET: code.push_back(EncI(OPC_JALR, 0, REG_X0, REG_RA, 0)); break;
+        default:
+          assert(false);
+      }
+    }
+  }
+
+  PutName(out, func.name);
+  Put<uint32_t>(out, code.size() * 4);
+  for (uint32_t word : code)
+    Put(out, word);
+
+  string label;
+  size_t label_num = 0;
+  for (auto &block : func.blocks)
+    label_num += block.label != nullptr;
+  Put<uint32_t>(out, label_num);
+  for (size_t b = 0; b < func.blocks.size(); ++b) {
+    if (!func.blocks[b].label)
+      continue;
+    // same names as the assembly: <func>.<label>
+    label.assign(func.name).append(1, '.').append(func.blocks[b].label);
+    Put<uint32_t>(out, block_at[b]);
+    PutName(out, label);
+  }
+
+  Put<uint32_t>(out, calls.size());
+  for (auto &call : calls) {
+    Put<uint32_t>(out, call.first);
+    PutName(out, func.syms[call.second]);
+  }
+}
+
+/**
+ * @brief link the fragments of a unit into an ELF32 relocatable, see elf.hpp
+ */
+void WriteElf(const char *frags, size_t len, Emitter &out) {
+  enum { SEC_NULL, SEC_TEXT, SEC_RELA, SEC_DATA, SEC_BSS, SEC_SYMTAB, SEC_STRTAB, SEC_SHSTRTAB, SEC_NUM };
+  struct sym_t {
+    uint32_t name;  // in .strtab
+    uint32_t value;
+    uint8_t info;
+    uint16_t shndx;
+  };
+  struct rela_t {
+    uint32_t offset;
+    uint32_t global;
+  };
+
+  string text;
+  string strtab(1, '\0');
+  vector<sym_t> locals = {
+    {0, 0, 0, SEC_NULL},
+    {0, 0, 3, SEC_TEXT},  // STB_LOCAL, STT_SECTION
+    {0, 0, 3, SEC_DATA},
+    {0, 0, 3, SEC_BSS},
+  };
+  vector<sym_t> globals;  // in order of appearance, undefined until defined
+  unordered_map<string_view, uint32_t> global_ids;
+  vector<rela_t> relas;
+
+  auto add_name = [&](string_view name) {
+    uint32_t at = strtab.size();
+    strtab.append(name).append(1, '\0');
+    return at;
+  };
+  auto global = [&](string_view name) {
+    auto it = global_ids.find(name);
+    if (it != global_ids.end())
+      return it->second;
+    global_ids[name] = globals.size();
+    globals.push_back({add_name(name), 0, 0x10, SEC_NULL});  // STB_GLOBAL, STT_NOTYPE
+    return (uint32_t)globals.size() - 1;
+  };
+
+  FragReader frag(frags, len);
+  while (!frag.Done()) {
+    uint32_t base = text.size();
+    sym_t &func = globals[global(frag.Name())];
+    assert(func.shndx == SEC_NULL);  // defined once
+    func.value = base;
+    func.shndx = SEC_TEXT;
+    text.append(frag.Bytes(frag.Word()));
+    for (uint32_t n = frag.Word(); n; --n) {
+      uint32_t offset = frag.Word();
+      locals.push_back({add_name(frag.Name()), base + offset, 0, SEC_TEXT});
+    }
+    for (uint32_t n = frag.Word(); n; --n) {
+      uint32_t offset = frag.Word();
+      relas.push_back({base + offset, global(frag.Name())});
+    }
+  }
+
+  const char shstrtab[] = "\0.text\0.rela.text\0.data\0.bss\0.symtab\0.strtab\0.shstrtab";
+  const uint32_t sh_names[SEC_NUM] = {0, 1, 7, 18, 24, 29, 37, 45};
+
+  // header, .text, .rela.text, .symtab, .strtab, .shstrtab, section headers
+  const uint32_t EHDR_SIZE = 52, SHDR_SIZE = 40, SYM_SIZE = 16, RELA_SIZE = 12;
+  uint32_t text_off = EHDR_SIZE;
+  uint32_t rela_off = (text_off + text.size() + 3) / 4 * 4;
+  uint32_t symtab_off = rela_off + relas.size() * RELA_SIZE;
+  uint32_t symtab_size = (locals.size() + globals.size()) * SYM_SIZE;
+  uint32_t strtab_off = symtab_off + symtab_size;
+  uint32_t shstrtab_off = strtab_off + strtab.size();
+  uint32_t shdr_off = (shstrtab_off + sizeof(shstrtab) + 3) / 4 * 4;
+
+  // ELF header
+  const char ident[16] = {0x7f, 'E', 'L', 'F', 1 /* 32 bit */, 1 /* little endian */, 1 /* version */};
+  out.Write(ident, sizeof(ident));
+  Put<uint16_t>(out, 1);    // ET_REL
+  Put<uint16_t>(out, 243);  // EM_RISCV
+  Put<uint32_t>(out, 1);    // EV_CURRENT
+  Put<uint32_t>(out, 0);    // entry
+  Put<uint32_t>(out, 0);    // program headers
+  Put<uint32_t>(out, shdr_off);
+  Put<uint32_t>(out, 0);    // flags: soft float abi, no rvc
+  Put<uint16_t>(out, EHDR_SIZE);
+  Put<uint16_t>(out, 0);
+  Put<uint16_t>(out, 0);
+  Put<uint16_t>(out, SHDR_SIZE);
+  Put<uint16_t>(out, SEC_NUM);
+  Put<uint16_t>(out, SEC_SHSTRTAB);
+
+  out << text;
+  for (uint32_t at = text_off + text.size(); at < rela_off; ++at)
+    out << '\0';
+  uint32_t first_global = locals.size();
+  for (auto &rela : relas) {
+    Put<uint32_t>(out, rela.offset);
+    Put<uint32_t>(out, (first_global + rela.global) << 8 | R_RISCV_CALL_PLT);
+    Put<int32_t>(out, 0);  // addend
+  }
+  for (auto *syms : {&locals, &globals}) {
+    for (auto &sym : *syms) {
+      Put<uint32_t>(out, sym.name);
+      Put<uint32_t>(out, sym.value);
+      Put<uint32_t>(out, 0);  // size
+      Put<uint8_t>(out, sym.info);
+      Put<uint8_t>(out, 0);   // default visibility
+      Put<uint16_t>(out, sym.shndx);
+    }
+  }
+  out << strtab;
+  out.Write(shstrtab, sizeof(shstrtab));
+  for (uint32_t at = shstrtab_off + sizeof(shstrtab); at < shdr_off; ++at)
+    out << '\0';
+
+  // section headers: name, type, flags, addr, offset, size, link, info, align, entsize
+  auto shdr = [&](int sec, uint32_t type, uint32_t flags, uint32_t offset, uint32_t size,
+                  uint32_t link, uint32_t info, uint32_t align, uint32_t entsize) {
+    for (uint32_t field : {sh_names[sec], type, flags, 0u, offset, size, link, info, align, entsize})
+      Put(out, field);
+  };
+  shdr(SEC_NULL, 0, 0, 0, 0, 0, 0, 0, 0);
+  shdr(SEC_TEXT, 1, 0x6, text_off, text.size(), 0, 0, 4, 0);          // PROGBITS, AX
+  shdr(SEC_RELA, 4, 0x40, rela_off, relas.size() * RELA_SIZE,         // RELA, I
+       SEC_SYMTAB, SEC_TEXT, 4, RELA_SIZE);
+  shdr(SEC_DATA, 1, 0x3, rela_off + relas.size() * RELA_SIZE, 0, 0, 0, 1, 0);  // PROGBITS, WA
+  shdr(SEC_BSS, 8, 0x3, symtab_off, 0, 0, 0, 1, 0);                   // NOBITS, WA
+  shdr(SEC_SYMTAB, 2, 0, symtab_off, symtab_size, SEC_STRTAB, first_global, 4, SYM_SIZE);
+  shdr(SEC_STRTAB, 3, 0, strtab_off, strtab.size(), 0, 0, 1, 0);
+  shdr(SEC_SHSTRTAB, 3, 0, shstrtab_off, sizeof(shstrtab), 0, 0, 1, 0);
+}
@@ -0,0 +1,30 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <emitter.hpp>
+#include <mir.hpp>
+
+#include <cstddef>
+
+using namespace std;
+
+// -obj: machine code straight into an ELF32 RISC-V relocatable object, the
+// same bytes the assembler makes of the -riscv output (as -mno-relax):
+// pseudo instructions expand as the assembler does, branches to labels are
+// resolved here (out of range ones become an inverted branch over a jal)
+// and every call is an R_RISCV_CALL_PLT on an auipc + jalr pair
+//
+// functions are encoded on their own, in parallel and cached like the
+// assembly, into fragments the write phase appends in source order:
+//   name, code, labels: count then (offset, name), calls: count then (offset, callee)
+// a number is a 4 byte little endian word, a name its length then its bytes,
+// offsets are from the start of the function
+void EncodeFunc(const MirFunc &func, Emitter &out);
+
+// link the appended fragments of a unit into one object:
+//   .text, .rela.text, .data, .bss, .symtab, .strtab, .shstrtab
+// labels are local symbols, functions and callees not defined in the unit
+// (the runtime: putint, getint, ...) global ones
+void WriteElf(const char *frags, size_t len, Emitter &out);
+
+#endif
@@ -0,0 +1,149 @@
+#include <emitter.hpp>
+
+#include <memstat.hpp>
+
+#include <cassert>
+#include <cstdlib>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+Emitter::~Emitter() {
+  Close();
+  if (!mapped)
+    free(buf);
+}
+
+/**
+ * @brief send output to a file from now on
+ *
+ * @param path output file
+ * @param use_mmap write straight into the mapped file instead of write(2)
+ * @return bool whether the file is opened
+ */
+bool Emitter::Open(const char* path, bool use_mmap) {
+  Close();
+  fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+
+  if (use_mmap) {
+    free(buf);
+    buf = nullptr;
+    cap = len = 0;
+    mapped = true;
+  }
+  Reserve(0);
+  return true;
+}
+
+void Emitter::Reserve(size_t n) {
+  if (mapped) {
+    // grow the file and map it again
+    size_t new_cap = cap ? cap : DEFAULT_CAPACITY;
+    while (new_cap < len + n)
+      new_cap *= 2;
+    if (new_cap == cap)
+      return;
+    if (buf)
+      munmap(buf, cap);
+    if (ftruncate(fd, new_cap) != 0)
+      throw bad_alloc();
+    void* p = mmap(nullptr, new_cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      throw bad_alloc();
+    buf = static_cast<char*>(p);
+    cap = new_cap;
+    return;
+  }
+
+  if (!buf) {
+    cap = fd >= 0 ? DEFAULT_CAPACITY : MEMORY_CAPACITY;
+    buf = static_cast<char*>(malloc(cap));
+    if (!buf)
+      throw bad_alloc();
+    MemCount(MEM_OUTPUT, cap);
+  }
+  if (fd >= 0) {
+    // file backed: a full buffer goes to the file
+    if (len + n > cap)
+      Flush();
+    return;
+  }
+
+  // in memory: keep everything
+  size_t new_cap = cap;
+  while (new_cap < len + n)
+    new_cap *= 2;
+  if (new_cap != cap) {
+    char* p = static_cast<char*>(realloc(buf, new_cap));
+    if (!p)
+      throw bad_alloc();
+    MemCount(MEM_OUTPUT, new_cap - cap);
+    buf = p;
+    cap = new_cap;
+  }
+}
+
+static void write_all(int fd, const char* s, size_t n) {
+  while (n) {
+    ssize_t ret = write(fd, s, n);
+    assert(ret > 0);
+    s += ret;
+    n -= ret;
+  }
+}
+
+void Emitter::WriteSlow(const char* s, size_t n) {
+  Reserve(n);
+  if (n > cap - len) {
+    // larger than the whole buffer, write through
+    write_all(fd, s, n);
+    return;
+  }
+  memcpy(buf + len, s, n);
+  len += n;
+}
+
+// a mapped file needs no flush, in memory output has nowhere to go
+void Emitter::Flush() {
+  if (fd < 0 || mapped)
+    return;
+  write_all(fd, buf, len);
+  len = 0;
+}
+
+void Emitter::Close() {
+  if (fd < 0)
+    return;
+  if (mapped) {
+    munmap(buf, cap);
+    // cut the file back to what was written
+    int ret = ftruncate(fd, len);
+    assert(ret == 0);
+    (void)ret;
+    buf = nullptr;
+    cap = 0;
+    mapped = false;
+  } else {
+    Flush();
+  }
+  close(fd);
+  fd = -1;
+  len = 0;
+}
+
+Emitter& Emitter::operator<<(int value) {
+  char tmp[12];  // "-2147483648"
+  char* p = tmp + sizeof(tmp);
+  unsigned int u = value < 0 ? 0u - (unsigned int)value : value;
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u);
+  if (value < 0)
+    *--p = '-';
+  Write(p, tmp + sizeof(tmp) - p);
+  return *this;
+}
@@ -0,0 +1,70 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+// buffered text output shared by the koopa and riscv printers
+// - not opened: grows in memory, read back with data()/size()
+// - Open(path): flushes the buffer with write(2) only when it is full
+// - Open(path, true): the buffer is the mmap'd output file itself
+class Emitter {
+ private:
+  static const size_t DEFAULT_CAPACITY = 1 << 20;  // file backed
+  static const size_t MEMORY_CAPACITY = 1 << 12;    // in memory, grows on demand
+
+  char* buf = nullptr;
+  size_t cap = 0;
+  size_t len = 0;
+  int fd = -1;
+  bool mapped = false;
+
+  void Reserve(size_t n);  // make room for n more bytes
+
+ public:
+  Emitter() = default;
+  Emitter(const Emitter&) = delete;
+  Emitter& operator=(const Emitter&) = delete;
+  ~Emitter();
+
+  bool Open(const char* path, bool use_mmap = false);
+  void Flush();
+  void Close();
+
+  void Write(const char* s, size_t n) {
+    if (len + n > cap) {
+      WriteSlow(s, n);
+      return;
+    }
+    memcpy(buf + len, s, n);
+    len += n;
+  }
+  void WriteSlow(const char* s, size_t n);
+
+  Emitter& operator<<(char c) {
+    if (len == cap)
+      Reserve(1);
+    buf[len++] = c;
+    return *this;
+  }
+  Emitter& operator<<(const char* s) {
+    Write(s, strlen(s));
+    return *this;
+  }
+  Emitter& operator<<(const string& s) {
+    Write(s.data(), s.size());
+    return *this;
+  }
+  Emitter& operator<<(int value);
+
+  // in memory use
+  const char* data() const { return buf; }
+  size_t size() const { return len; }
+  void Truncate(size_t n) { if (n < len) len = n; }
+  void Clear() { len = 0; }
+};
+
+#endif
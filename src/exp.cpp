@@ -0,0 +1,261 @@
+#include <exp.hpp>
+
+#include <context.hpp>
+
+#include <cassert>
+
+exp_id_t ExpPool::Add(exp_op_t code, uint32_t l, uint32_t r, uint32_t from) {
+  exp_id_t id = op.size();
+  op.push_back(code);
+  flags.push_back(0);
+  lhs.push_back(l);
+  rhs.push_back(r);
+  first.push_back(from);
+  val.push_back(0);
+  tmp.push_back(0);
+  return id;
+}
+
+exp_id_t ExpPool::Number(int value) {
+  exp_id_t id = op.size();
+  Add(EXP_NUMBER, 0, 0, id);
+  flags[id] = EVALUATED | NUMBER | CONST;
+  val[id] = value;
+  return id;
+}
+
+exp_id_t ExpPool::LVal(sym_id_t ident) {
+  return Add(EXP_LVAL, ident, 0, op.size());
+}
+
+void ExpPool::SetAtLeft(exp_id_t id) {
+  assert(op[id] == EXP_LVAL);
+  flags[id] |= AT_LEFT;
+}
+
+exp_id_t ExpPool::Unary(op_t unary_op, exp_id_t operand) {
+  if (unary_op == OP_ADD)
+    return operand;  // nothing to do
+  return Add(unary_op == OP_SUB ? EXP_NEG : EXP_NOT, operand, 0, first[operand]);
+}
+
+exp_id_t ExpPool::Binary(op_t binary_op, exp_id_t l, exp_id_t r) {
+  static const exp_op_t codes[] = {
+      EXP_NUMBER, EXP_ADD, EXP_SUB, EXP_NOT, EXP_MUL, EXP_DIV, EXP_MOD,
+      EXP_LT, EXP_GT, EXP_LE, EXP_GE, EXP_EQ, EXP_NE,
+  };
+  assert(binary_op != OP_NONE && binary_op != OP_NOT);
+  return Add(codes[binary_op], l, r, first[l]);
+}
+
+exp_id_t ExpPool::LogicRhs(exp_id_t l) {
+  return Add(EXP_RHS, l, 0, first[l]);
+}
+
+exp_id_t ExpPool::Logic(exp_op_t code, exp_id_t rhs_node, exp_id_t r) {
+  exp_id_t id = Add(code, rhs_node, r, first[rhs_node]);
+  rhs[rhs_node] = id;
+  return id;
+}
+
+void ExpPool::PushArg(exp_id_t arg) {
+  arg_stack.push_back(arg);
+}
+
+exp_id_t ExpPool::Call(sym_id_t ident, int argc) {
+  // calls nest, the innermost one is completed first
+  size_t from = arg_stack.size() - argc;
+  exp_id_t id = Add(EXP_CALL, args.size(), argc, argc ? first[arg_stack[from]] : op.size());
+  val[id] = ident;
+  args.insert(args.end(), arg_stack.begin() + from, arg_stack.end());
+  arg_stack.resize(from);
+  return id;
+}
+
+string ExpPool::Repr(exp_id_t id) const {
+  if (flags[id] & NUMBER)
+    return to_string(val[id]);
+  return "%" + to_string(tmp[id]);
+}
+
+string ExpPool::MemAddr(exp_id_t id) const {
+  return get<string>(ctx->symtab_stack.Lookup(lhs[id]));
+}
+
+static int Fold(exp_op_t code, int l, int r) {
+  switch (code) {
+    case EXP_MUL: return l * r;
+    case EXP_DIV: return l / r;
+    case EXP_MOD: return l % r;
+    case EXP_ADD: return l + r;
+    case EXP_SUB: return l - r;
+    case EXP_LT: return l < r;
+    case EXP_GT: return l > r;
+    case EXP_LE: return l <= r;
+    case EXP_GE: return l >= r;
+    case EXP_EQ: return l == r;
+    case EXP_NE: return l != r;
+    case EXP_AND: return l && r;
+    case EXP_OR: return l || r;
+    default: assert(false);
+  }
+  return 0;
+}
+
+void ExpPool::Eval(exp_id_t root, bool discarded) {
+  // operands come first, an evaluated node has evaluated operands only
+  for (exp_id_t i = first[root]; i <= root; ++i) {
+    if (flags[i] & EVALUATED)
+      continue;
+
+    switch (op[i]) {
+      case EXP_RHS:
+        continue;
+      case EXP_LVAL: {
+        const string &name = ctx->interner.Name(lhs[i]);
+        if (!ctx->symtab_stack.Exist(lhs[i], false)) {
+          // reads as 0, the assignment is dropped
+          SemanticError("undefined variable %s", name.c_str());
+          flags[i] |= NUMBER;
+          val[i] = 0;
+          break;
+        }
+        const sym_t &sym = ctx->symtab_stack.Lookup(lhs[i]);
+        if (sym.index() == 0) {
+          // const
+          flags[i] |= NUMBER;
+          val[i] = get<int>(sym);
+          if (flags[i] & AT_LEFT)
+            SemanticError("assignment to constant %s", name.c_str());
+        } else if (!(flags[i] & AT_LEFT)) {
+          tmp[i] = NewTempVar();
+        }
+        break;
+      }
+      case EXP_CALL: {
+        const string &name = ctx->interner.Name(val[i]);
+        if (!ctx->functab.Exist(val[i])) {
+          SemanticError("undefined function %s", name.c_str());
+        } else if (ctx->functab.Lookup(val[i]) == TYPE_VOID && !(discarded && i == root)) {
+          SemanticError("void function %s used as a value", name.c_str());
+          flags[i] |= VOID_USED;
+        }
+        tmp[i] = NewTempVar();
+        break;
+      }
+      case EXP_NEG:
+      case EXP_NOT: {
+        exp_id_t a = lhs[i];
+        flags[i] |= flags[a] & (NUMBER | CONST);
+        if (flags[a] & NUMBER)
+          val[i] = op[i] == EXP_NEG ? -val[a] : !val[a];
+        else
+          tmp[i] = NewTempVar();
+        break;
+      }
+      default: {
+        // binary, the left operand of && / || is behind its EXP_RHS
+        exp_id_t a = op[i] == EXP_AND || op[i] == EXP_OR ? lhs[lhs[i]] : lhs[i];
+        exp_id_t b = rhs[i];
+        flags[i] |= flags[a] & flags[b] & (NUMBER | CONST);
+        if (flags[i] & NUMBER)
+          val[i] = Fold(static_cast<exp_op_t>(op[i]), val[a], val[b]);
+        else
+          tmp[i] = NewTempVar();
+        break;
+      }
+    }
+    if (!(flags[i] & CONST))
+      flags[i] |= EVALUATED;
+  }
+}
+
+void ExpPool::Dump(exp_id_t root) {
+  static const koopa_raw_binary_op_t binary_ops[] = {
+      KOOPA_RBO_MUL, KOOPA_RBO_DIV, KOOPA_RBO_MOD, KOOPA_RBO_ADD, KOOPA_RBO_SUB,
+      KOOPA_RBO_LT, KOOPA_RBO_GT, KOOPA_RBO_LE, KOOPA_RBO_GE, KOOPA_RBO_EQ, KOOPA_RBO_NOT_EQ,
+  };
+  auto builder = ctx->ir_builder;
+
+  for (exp_id_t i = first[root]; i <= root; ++i) {
+    switch (op[i]) {
+      case EXP_NUMBER:
+        break;
+      case EXP_LVAL:
+        // a const is just the number, an assigned lval is not loaded
+        if (!(flags[i] & (NUMBER | AT_LEFT)))
+          builder->Load(Repr(i), MemAddr(i));  // %0 = load @x
+        break;
+      case EXP_CALL: {
+        // %0 = call @half(10, %2)
+        vector<string> reprs;
+        for (uint32_t k = 0; k < rhs[i]; ++k)
+          reprs.push_back(Repr(args[lhs[i] + k]));
+        const string &name = ctx->interner.Name(val[i]);
+        bool is_void = ctx->functab.Exist(val[i]) && ctx->functab.Lookup(val[i]) == TYPE_VOID;
+        if (is_void && !(flags[i] & VOID_USED))
+          builder->Call("", name, reprs);
+        else
+          builder->Call(Repr(i), name, reprs);
+        break;
+      }
+      case EXP_NEG:
+        if (!(flags[i] & NUMBER))
+          builder->Binary(KOOPA_RBO_SUB, Repr(i), "0", Repr(lhs[i]));
+        break;
+      case EXP_NOT:
+        if (!(flags[i] & NUMBER))
+          builder->Binary(KOOPA_RBO_EQ, Repr(i), Repr(lhs[i]), "0");
+        break;
+      case EXP_RHS: {
+        /* short circuit, the left operand is dumped:
+         * int result = 0 (&&) / 1 (||);
+         * if (lhs != 0 (&&) / lhs == 0 (||)) {
+         *   result = rhs != 0;
+         * }
+         */
+        exp_id_t node = rhs[i];
+        if (flags[node] & NUMBER)
+          break;
+        val[i] = ctx->label_cnt++;
+        string label_then = "%then_" + to_string(val[i]);
+        string label_else = "%else_" + to_string(val[i]);
+        // create result on stack, the temp of rhs != 0 follows it
+        tmp[i] = ctx->tmp_var_no;
+        ctx->tmp_var_no += 2;
+        builder->Alloc("%" + to_string(tmp[i]));
+        if (op[node] == EXP_AND)
+          builder->Branch(Repr(lhs[i]), label_then, label_else);
+        else
+          builder->Branch(Repr(lhs[i]), label_else, label_then);
+        builder->Label(label_then);
+        break;
+      }
+      case EXP_AND:
+      case EXP_OR: {
+        if (flags[i] & NUMBER)
+          break;
+        // the right operand is dumped: result = rhs != 0
+        exp_id_t rhs_node = lhs[i];
+        string result = "%" + to_string(tmp[rhs_node]);
+        string tmp_rhs = "%" + to_string(tmp[rhs_node] + 1);
+        string label_else = "%else_" + to_string(val[rhs_node]);
+        string label_end = "%end_" + to_string(val[rhs_node]);
+        builder->Binary(KOOPA_RBO_NOT_EQ, tmp_rhs, Repr(rhs[i]), "0");
+        builder->Store(tmp_rhs, result);
+        builder->Jump(label_end);
+        // label else (result = lhs)
+        builder->Label(label_else);
+        builder->Store(op[i] == EXP_AND ? "0" : "1", result);
+        builder->Jump(label_end);
+        builder->Label(label_end);
+        builder->Load(Repr(i), result);
+        break;
+      }
+      default:
+        if (!(flags[i] & NUMBER))
+          builder->Binary(binary_ops[op[i] - EXP_MUL], Repr(i), Repr(lhs[i]), Repr(rhs[i]));
+        break;
+    }
+  }
+}
@@ -0,0 +1,94 @@
+#ifndef EXP_H
+#define EXP_H
+
+#include <global.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef uint32_t exp_id_t;  // index of an expression node in the pool
+
+// expression opcodes
+typedef enum : uint8_t {
+  EXP_NUMBER,  // val
+  EXP_LVAL,    // lhs: identifier
+  EXP_CALL,    // lhs: first argument in args, rhs: argument count, val: identifier
+  EXP_NEG,     // lhs: operand (unary + builds no node)
+  EXP_NOT,
+  EXP_MUL,     // lhs op rhs
+  EXP_DIV,
+  EXP_MOD,
+  EXP_ADD,
+  EXP_SUB,
+  EXP_LT,
+  EXP_GT,
+  EXP_LE,
+  EXP_GE,
+  EXP_EQ,
+  EXP_NE,
+  EXP_AND,     // lhs: its EXP_RHS, rhs: right operand
+  EXP_OR,
+  EXP_RHS,     // start of the right operand of && / ||, lhs: left operand, rhs: the && / || node
+} exp_op_t;
+
+// all expressions of a compile unit, struct of arrays
+// nodes are added by the parser, so every node comes after its operands
+// and a subtree is the range [first, root]: Eval and Dump are plain loops
+// over it. The nodes of a function are contiguous as well, functions
+// lowered in parallel only write their own range.
+// && and || put a EXP_RHS node between their operands, it emits the
+// short circuit branch when the loop gets there
+class ExpPool {
+ private:
+  enum : uint8_t {
+    EVALUATED = 1,  // not evaluated again (a const expression is)
+    NUMBER = 2,     // val is known
+    CONST = 4,      // built from literals only
+    AT_LEFT = 8,    // lval assigned to
+    VOID_USED = 16, // void call used as a value (an error), defines its temp var anyway
+  };
+
+  vector<uint8_t> op;       // exp_op_t
+  vector<uint8_t> flags;
+  vector<uint32_t> lhs;
+  vector<uint32_t> rhs;
+  vector<uint32_t> first;   // first node of the subtree
+  vector<int32_t> val;      // value of a number / label of a EXP_RHS
+  vector<int32_t> tmp;      // temp var of a non number (%tmp) / result of a EXP_RHS
+  vector<exp_id_t> args;    // arguments of the calls, contiguous per call
+  vector<exp_id_t> arg_stack;  // arguments of the calls being parsed
+
+  exp_id_t Add(exp_op_t code, uint32_t l, uint32_t r, uint32_t from);
+
+ public:
+  // building, in post order
+  exp_id_t Number(int value);
+  exp_id_t LVal(sym_id_t ident);
+  void SetAtLeft(exp_id_t id);
+  exp_id_t Unary(op_t op, exp_id_t operand);
+  exp_id_t Binary(op_t op, exp_id_t l, exp_id_t r);
+  exp_id_t LogicRhs(exp_id_t l);  // after the left operand of && / ||
+  exp_id_t Logic(exp_op_t code, exp_id_t rhs_node, exp_id_t r);
+  void PushArg(exp_id_t arg);
+  exp_id_t Call(sym_id_t ident, int argc);  // takes the last argc arguments pushed
+
+  // get the value or temp var of every node of the subtree, the value of
+  // root is discarded in an expression statement (a void call is fine)
+  void Eval(exp_id_t root, bool discarded = false);
+  // emit the code of every node of the subtree, after Eval
+  void Dump(exp_id_t root);
+
+  bool IsNumber(exp_id_t id) const { return flags[id] & NUMBER; }
+  int Value(exp_id_t id) const { return val[id]; }
+  // the number, or the temp var holding the value
+  string Repr(exp_id_t id) const;
+  // memory of an lval (a variable)
+  string MemAddr(exp_id_t id) const;
+
+  size_t size() const { return op.size(); }
+};
+
+#endif
@@ -1,31 +1,81 @@
 #include <cassert>
+#include <cstdarg>
+#include <cstdio>
+#include <context.hpp>
 #include <global.hpp>
+#include <trace.hpp>
 
-int label_cnt = 0;
-int ret_label_cnt = 0;
-int tmp_var_no = 0;
-string NewTempVar() {
-  printf(" [debug] renew tmp var: %d\n", tmp_var_no);
-  return "%" + to_string(tmp_var_no++);
+int NewTempVar() {
+  TRACE(TRACE_IRGEN, TRACE_VERBOSE, "renew tmp var: %d", ctx->tmp_var_no);
+  return ctx->tmp_var_no++;
 }
-SymTabStack symtab_stack;
-WhileStack while_stack;
-FuncTab functab;
 
+void SemanticError(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "error: ");
+  vfprintf(stderr, fmt, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+  ctx->error = true;
+}
+
+const char* op_str(op_t op) {
+  static const char* strs[] = {
+    "", "+", "-", "!", "*", "/", "%", "<", ">", "<=", ">=", "==", "!=",
+  };
+  return strs[op];
+}
+
+// ==================== Interner ==================== //
+
+sym_id_t Interner::Intern(string_view name) {
+  auto it = ids.find(name);
+  if (it != ids.end())
+    return it->second;
+
+  sym_id_t id = names.size();
+  names.emplace_back(name);
+  ids.emplace(names.back(), id);
+  return id;
+}
 
 // ==================== SymTabStack ==================== //
 
 // SymTabStack methods
+vector<SymTabStack::entry_t>& SymTabStack::Entries(sym_id_t symbol) {
+  if (symbol >= shadow.size())
+    shadow.resize(symbol + 1);
+  return shadow[symbol];
+}
+
+void SymTabStack::Define(sym_id_t symbol, sym_t sym) {
+  // the later one shadows the first for the rest of the scope
+  if (Exist(symbol, true))
+    SemanticError("redefinition of %s", ctx->interner.Name(symbol).c_str());
+  Entries(symbol).push_back({level, move(sym)});
+  undo.push_back(symbol);
+}
+
+// entering a scope only records a mark, no table is created
 void SymTabStack::Push() {
   cnt++;
-  printf(" [debug] push symtab#%d\n", cnt);
-  stk.push_back(symtab_t());
+  TRACE(TRACE_SYMTAB, TRACE_DEBUG, "push symtab#%d", cnt);
+  level++;
+  marks.push_back(undo.size());
 }
 
+// undo the definitions made in the innermost scope
 void SymTabStack::Pop() {
-  printf(" [debug] pop symtab#%d\n", cnt);
-  assert(cnt > 0);
-  stk.pop_back();
+  TRACE(TRACE_SYMTAB, TRACE_DEBUG, "pop symtab#%d", cnt);
+  assert(level > 0);
+  size_t mark = marks.back();
+  marks.pop_back();
+  while (undo.size() > mark) {
+    shadow[undo.back()].pop_back();
+    undo.pop_back();
+  }
+  level--;
   // cnt--;
 }
 
@@ -35,9 +85,8 @@ void SymTabStack::Pop() {
  * @param symbol 
  * @param value constant value (int)
  */
-void SymTabStack::Insert(unique_ptr<string>& symbol, int value) {
-  assert(!Exist(symbol, true));
-  stk.back()[*symbol] = value;
+void SymTabStack::Insert(sym_id_t symbol, int value) {
+  Define(symbol, value);
 }
 
 /**
@@ -46,64 +95,50 @@ void SymTabStack::Insert(unique_ptr<string>& symbol, int value) {
  * @param symbol 
  * @return string memory address name
  */
-string SymTabStack::Insert(unique_ptr<string>& symbol) {
-  assert(!Exist(symbol, true));
-  string name = "@" + *symbol + "_" + to_string(cnt);
-  printf(" [debug] alloc %s\n", name.c_str());
-  stk.back()[*symbol] = name;
+string SymTabStack::Insert(sym_id_t symbol) {
+  string name = "@" + ctx->interner.Name(symbol) + "_" + to_string(cnt);
+  TRACE(TRACE_SYMTAB, TRACE_DEBUG, "alloc %s", name.c_str());
+  Define(symbol, name);
   return name;
 }
 
 /**
- * @brief search through all symtab in the stack (inversely)
+ * @brief whether the symbol is visible, O(1)
  * 
  * @param symbol 
  * @param cur_level only search in the current level symtab
  * @return bool whether exist 
  */
-bool SymTabStack::Exist(unique_ptr<string>& symbol, bool cur_level=false) {
-  int layer = 0;
-  // reverse
-  for (auto symtab_it = stk.rbegin(); symtab_it != stk.rend(); symtab_it++) {
-    auto it = symtab_it->find(*symbol);
-    if (it != symtab_it->end())
-      return true;
-    layer++;
-
-    if (cur_level && layer >= 1)
-      break;
-  }
-  return false;
-}
-
-sym_t SymTabStack::Lookup(unique_ptr<string>& symbol) {
-  // todo use const and refer in future
-  // assert(Exist(symbol));
-  // reverse
-  for (auto symtab_it = stk.rbegin(); symtab_it != stk.rend(); symtab_it++) {
-    auto it = symtab_it->find(*symbol);
-    if (it != symtab_it->end()) {
-      return it->second;
-    }
-  }
-  assert(false);
+bool SymTabStack::Exist(sym_id_t symbol, bool cur_level=false) {
+  if (symbol >= shadow.size() || shadow[symbol].empty())
+    return false;
+  return !cur_level || shadow[symbol].back().level == level;
+}
+
+const sym_t& SymTabStack::Lookup(sym_id_t symbol) {
+  assert(Exist(symbol));
+  return shadow[symbol].back().sym;
 }
 
 // ==================== Global Sym Tab ==================== //
 
-bool FuncTab::Exist(string symbol) {
+bool FuncTab::Exist(sym_id_t symbol) const {
   auto it = func_map.find(symbol);
   return it != func_map.end();
 }
 
-void FuncTab::Insert(string symbol, string func_type) {
-  assert(!Exist(symbol));
+void FuncTab::Insert(sym_id_t symbol, btype_t func_type) {
+  if (Exist(symbol)) {
+    SemanticError("redefinition of function %s", ctx->interner.Name(symbol).c_str());
+    return;
+  }
   func_map[symbol] = func_type;
 }
 
-string FuncTab::Lookup(unique_ptr<string>& symbol) {
-  assert(Exist(*symbol));
-  return func_map[*symbol];
+// const: function tasks look up the unit's table concurrently
+btype_t FuncTab::Lookup(sym_id_t symbol) const {
+  assert(Exist(symbol));
+  return func_map.at(symbol);
 }
 
 // ==================== WhileStack ==================== //
@@ -118,7 +153,7 @@ labels_t WhileStack::get_label(int i) {
 }
 
 labels_t WhileStack::Push() {
-  // printf(" [debug] push while#%d\n", cnt);
+  TRACE(TRACE_SYMTAB, TRACE_VERBOSE, "push while#%d", cnt);
   stk.push(cnt);
   labels_t labels = get_label(cnt);
   cnt++;
@@ -127,7 +162,7 @@ labels_t WhileStack::Push() {
 }
 
 void WhileStack::Pop() {
-  // printf(" [debug] pop while#%d\n", cnt);
+  TRACE(TRACE_SYMTAB, TRACE_VERBOSE, "pop while#%d", stk.top());
   stk.pop();
 }
 
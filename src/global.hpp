@@ -1,9 +1,13 @@
 #ifndef GLOBAL_H
 #define GLOBAL_H
 
+#include <cstdint>
+#include <deque>
 #include <map>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 #include <stack>
@@ -11,27 +15,77 @@
 
 using namespace std;
 
+typedef uint32_t sym_id_t;  // interned identifier
 typedef variant<int, string> sym_t;
-typedef map<string, sym_t> symtab_t;
 typedef tuple<string, string, string> labels_t;
+class Interner;
 class SymTabStack;
 class FuncTab;
 class WhileStack;
 
-extern int label_cnt;
-extern int ret_label_cnt;
-extern int tmp_var_no;  // current temp variable number
-string NewTempVar();
-extern SymTabStack symtab_stack;
-extern WhileStack while_stack;    // to maintain multi while
-extern FuncTab functab;
+// basic types (function return / declaration type)
+typedef enum {
+  TYPE_INT,
+  TYPE_VOID,
+} btype_t;
 
+// expression operators, OP_NONE means no operator
+typedef enum {
+  OP_NONE,
+  OP_ADD,  // binary + or unary +
+  OP_SUB,  // binary - or unary -
+  OP_NOT,
+  OP_MUL,
+  OP_DIV,
+  OP_MOD,
+  OP_LT,
+  OP_GT,
+  OP_LE,
+  OP_GE,
+  OP_EQ,
+  OP_NE,
+} op_t;
+
+const char* op_str(op_t op);
+
+int NewTempVar();  // next temp var of the current compilation, %<n>
+
+// report a semantic error on stderr, lowering goes on to find more and
+// the compilation fails at its end (ctx->error)
+void SemanticError(const char *fmt, ...);
+
+
+// identifier -> compact id, the same name always gets the same id
+class Interner {
+ private:
+  deque<string> names;  // stable storage, viewed by ids
+  unordered_map<string_view, sym_id_t> ids;
+
+ public:
+  sym_id_t Intern(string_view name);
+  const string& Name(sym_id_t id) const { return names[id]; }
+  size_t size() const { return names.size(); }
+};
 
 // symbol table
+// every symbol keeps its own shadow stack (indexed by interned id), scopes
+// only remember which symbols they defined and undo them on Pop
 class SymTabStack {
  private:
-  int cnt = 0;  // global count for symtab, to avoid redifinition in a block
-  vector<symtab_t> stk;
+  // a definition of a symbol in some scope
+  struct entry_t {
+    int level;  // scope depth it is defined in
+    sym_t sym;
+  };
+
+  int cnt = 0;    // global count for symtab, to avoid redifinition in a block
+  int level = 0;  // current scope depth
+  vector<vector<entry_t>> shadow;  // symbol id -> definitions, innermost last
+  vector<sym_id_t> undo;           // symbols defined, in definition order
+  vector<size_t> marks;            // undo size at each scope entry
+
+  vector<entry_t>& Entries(sym_id_t symbol);
+  void Define(sym_id_t symbol, sym_t sym);
  
  public:
   // create stack
@@ -40,25 +94,26 @@ class SymTabStack {
   void Pop();
 
   // def const
-  void Insert(unique_ptr<string>& symbol, int value);
+  void Insert(sym_id_t symbol, int value);
   // def var (whether has init, whether init is int or lval)
-  string Insert(unique_ptr<string>& symbol);  // will create addr
+  string Insert(sym_id_t symbol);  // will create addr
   
-  bool Exist(unique_ptr<string>& symbol, bool cur_level);
-  sym_t Lookup(unique_ptr<string>& symbol);
+  bool Exist(sym_id_t symbol, bool cur_level);
+  const sym_t& Lookup(sym_id_t symbol);
+  int count() const { return cnt; }
 
   // todo ~SymTabStack();
 };
 
 class FuncTab {
  private:
-  map<string, string> func_map;
-  bool Exist(string symbol);
+  unordered_map<sym_id_t, btype_t> func_map;
  
  public:
-  void Insert(string symbol, string func_type);
+  void Insert(sym_id_t symbol, btype_t func_type);
+  bool Exist(sym_id_t symbol) const;
   
-  string Lookup(unique_ptr<string>& symbol);
+  btype_t Lookup(sym_id_t symbol) const;
   // todo ~GlbSymTab();
 };
 
@@ -72,6 +127,7 @@ class WhileStack {
   labels_t Push();
   void Pop();
   labels_t Top();  // get current while label
+  bool Empty() const { return stk.empty(); }  // outside of any while
 };
 
 #endif
\ No newline at end of file
@@ -1,156 +1,53 @@
+#include <context.hpp>
+#include <elf.hpp>
 #include <ir.hpp>
-#include <map>
-#include <vector>
-#include <cmath>
+#include <trace.hpp>
 
 using namespace std;
 
-// some global variables
-class Stack {
- private:
-  int stack_top = 0;   // stack top position
-  int stack_size = 0;  // stack length
- 
- public:
-  int inc_top(int size) {
-    printf("[debug stack] inc_stack: %d\n", size);
-    return stack_top += size;
-  }
-  
-  int get_top() {
-    return stack_top;
-  }
-
-  int get_size() {
-    return stack_size;
-  }
-  
-  void set_size(int size) {
-    printf("[debug stack] set_size: %d\n", size);
-    stack_size = size;
-  }
-
-  void clear() {
-    stack_top = 0;
-    stack_size = 0;
-  }
-} stack;
-
-// now reg allocator use three-level reg state to better allocate
-class RegAllocator {
- private:
-  // todo consider changing the regs into queue or other data structure to avoid loops
-  vector<reg_t> regs;
- 
- public:
-  RegAllocator() {
-    for (int i = 0; i < REGNUM; ++i) {
-      reg_t reg = {i, false};
-      regs.push_back(reg);
-    }
-  }
-
-  const reg_t& alloc() {
-    for (auto &reg : regs) {
-      if (!reg.occupied) {
-        // found free reg
-        reg.occupied = true;
-        return reg;
-      }
-    }
-    // i believe that currently reg won't be full
-    // todo a half written version is saved in git stash
-    
-    // no available register
-    assert(false);
-  }
-
-  /**
-   * @brief alloc specific reg
-   * 
-   * @param reg_id 
-   */
-  void alloc(int reg_id) {
-    assert(reg_id < REGNUM);  // x0 cannot be allocated
-    assert(regs[reg_id].occupied == false);
-    regs[reg_id].occupied = true;
-  }
-
-  void free() {
-    for (auto &reg : regs) {
-      reg.occupied = false;
-    }
-  }
+void ValueMap::Insert(koopa_raw_value_t value) {
+  size_t mask = keys.size() - 1;
+  size_t i = Hash(value) & mask;
+  while (keys[i])
+    i = (i + 1) & mask;
+  keys[i] = value;
+  ids[i] = reprs.size();
+  reprs.push_back({false, -1});
+  values.push_back(value);
+}
 
-  /**
-   * @brief free specific reg
-   * 
-   * @param reg_id 
-   */
-  void free(int reg_id) {
-    assert(reg_id < REGNUM);
-    regs[reg_id].occupied = false;
-  }
-} reg_allocator;
-
-string format_reg(int reg_num) {
-  string reg_str;
-  if (reg_num < 7) {  // t0 ~ t6
-    reg_str = "t" + to_string(reg_num);
-  } else if (reg_num < REGNUM) {  // a0 ~ a7
-    reg_str = "a" + to_string(reg_num - 7);
-  } else if (reg_num == REGNUM) {  // x0
-    reg_str = "x0";
-  } else {
-    assert(false);
+void ValueMap::Reset(const koopa_raw_function_t &func) {
+  size_t num = func->params.len;
+  for (size_t i = 0; i < func->bbs.len; ++i) {
+    auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+    num += bb->params.len + bb->insts.len;
   }
-  return reg_str;
-}
 
-// must use a value map, so when referred to a value pointer
-// it won't be dump twice
-map<const koopa_raw_value_t, repr_t> vmap;
-int ra_addr = -1;  // -1 means no ra address
-
-string get_op_str(koopa_raw_binary_op_t op) {
-  switch (op) {
-    case KOOPA_RBO_ADD:
-      return "add";
-    case KOOPA_RBO_SUB:
-      return "sub";
-    case KOOPA_RBO_MUL:
-      return "mul";
-    case KOOPA_RBO_DIV:
-      return "div";
-    case KOOPA_RBO_MOD:
-      return "rem";
-    case KOOPA_RBO_LT:
-      return "slt";
-    case KOOPA_RBO_AND:
-      return "and";
-    case KOOPA_RBO_OR:
-      return "or";
-    case KOOPA_RBO_GT:
-      return "sgt";
-    default:
-      assert(false);
+  // at most half full, the buffers are kept for the next function
+  size_t cap = 16;
+  while (cap < num * 2)
+    cap *= 2;
+  keys.assign(cap, nullptr);
+  ids.resize(cap);
+  reprs.clear();
+  reprs.reserve(num);
+  values.clear();
+
+  for (size_t i = 0; i < func->params.len; ++i)
+    Insert(reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]));
+  for (size_t i = 0; i < func->bbs.len; ++i) {
+    auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+    for (size_t j = 0; j < bb->params.len; ++j)
+      Insert(reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[j]));
+    for (size_t j = 0; j < bb->insts.len; ++j)
+      Insert(reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]));
   }
+  known.assign(num, false);
 }
 
-void gen_riscv(string koopa_str) {
-  printf("%s\n", koopa_str.c_str());
-  koopa_program_t program;
-  koopa_error_code_t ret = koopa_parse_from_string(koopa_str.c_str(), &program);
-  assert(ret == KOOPA_EC_SUCCESS);
-
-  koopa_raw_program_builder_t builder = koopa_new_raw_program_builder();
-  koopa_raw_program_t raw = koopa_build_raw_program(builder, program);
-  koopa_delete_program(program);
-
-  // handle raw before delete
+// raw program is built in memory by RawIRBuilder, no koopa text involved
+void gen_riscv(const koopa_raw_program_t &raw) {
   Visit(raw);
-
-  koopa_delete_raw_program_builder(builder);
 }
 
 // visit raw program
@@ -164,7 +61,7 @@ void Visit(const koopa_raw_program_t &program) {
 
 // visit raw slice
 void Visit(const koopa_raw_slice_t &slice) {
-  printf("visit slice\n");
+  TRACE(TRACE_BACKEND, TRACE_VERBOSE, "visit slice");
   for (size_t i = 0; i < slice.len; ++i) {
     auto ptr = slice.buffer[i];
     switch (slice.kind) {
@@ -183,175 +80,128 @@ void Visit(const koopa_raw_slice_t &slice) {
   }
 }
 
-// visit func
+// visit func: select instructions into ctx->mir, peephole, lay out the frame, print or encode
 void Visit(const koopa_raw_function_t &func) {
   // lib function
   if (func->bbs.len == 0) // decl
     return;
 
   // enter new function, all things are cleard
-  stack.clear();
-  ra_addr = -1;
-  reg_allocator.free();
-  vmap.clear();
-
-  // generate information
-  cout << "  .text" << endl;
-  cout << "  .globl " << func->name + 1 << endl;
-  cout << func->name + 1 << ":" << endl;
-  
-  // prepare stack size
-  int max_arg_num = 0;
-  bool save_ra = false;
-  int stack_size = 0;
-
-  // loop through basic blocks in the function
-  for (size_t i = 0; i < func->bbs.len; ++i) {
-    koopa_raw_basic_block_t bb_ptr = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
-    for (size_t j = 0; j < bb_ptr->insts.len; ++j) {
-      koopa_raw_value_t inst_ptr = reinterpret_cast<koopa_raw_value_t>(bb_ptr->insts.buffer[j]);
-      if (inst_ptr->ty->tag != KOOPA_RTT_UNIT) {
-        // only value with return is counted
-        stack_size += 4;
-      }
-      if (inst_ptr->kind.tag == KOOPA_RVT_CALL) {
-        // caller save ra
-        save_ra = true;
-        // get max arg num
-        int arg_num = inst_ptr->kind.data.call.args.len;
-        if (arg_num > max_arg_num) {
-          max_arg_num = arg_num;
-        }
-      }
-    }
-  }
-
-  // calculate stack size
-  int arg_in_stack_size = 0;
-  if (max_arg_num > 8) {
-    arg_in_stack_size = (max_arg_num - 8) * 4;
-  }
-  stack_size += arg_in_stack_size;
-  stack.inc_top(arg_in_stack_size);  // increase at once
-  // multi calls share the same save_ra_addr
-  if (save_ra)
-    stack_size += 4;
-  // align to 16
-  stack_size = ceil(stack_size / 16.0) * 16;
-  stack.set_size(stack_size);
-  if (stack_size) {
-    if (stack_size <= 2047)
-      cout << "  addi sp, sp, " << -stack_size << endl;
-    else {
-      cout << "  li t0, " << -stack_size << endl;
-      cout << "  addi sp, sp, t0" << endl;
-    }
-  }
-
-  // assign ra address
-  if (save_ra) {
-    ra_addr = stack.get_size() - 4;
-    cout << "  sw ra, " << ra_addr << "(sp)" << endl;
-  }
-
-  // params
+  MirFunc &mir = ctx->mir;
+  mir.Reset(func->name + 1);
+  ctx->vmap.Reset(func);
+  ctx->reg_alloc.Run(func);
+  for (size_t i = 0; i < func->bbs.len; ++i)
+    mir.AddBlock(reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i])->name + 1);
+
+  // params: the first 8 come in a0 ~ a7 and stay there unless spilled,
+  // the others are in the frame of the caller
   for (size_t i = 0; i < func->params.len; ++i) {
     koopa_raw_value_t param_value = reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]);
+    int id = ctx->vmap.Index(param_value);
     if (i < 8) {
-      int reg_id = i + 7;
-      reg_allocator.alloc(reg_id);
-      repr_t repr = {true, reg_id};
-      vmap[param_value] = repr;
+      if (!ctx->vmap.Known(id))
+        continue;  // unused
+      repr_t repr = ctx->vmap.Get(id);
+      if (repr.is_reg)
+        assert(repr.addr == REG_A0 + (int)i);
+      else
+        mir.Sw(REG_A0 + i, repr.base, repr.addr);
     } else {
-      int addr = stack.get_size() + (i - 8) * 4;
-      repr_t repr = {false, addr};
-      vmap[param_value] = repr;
+      repr_t repr = {false, (int)(i - 8) * 4, MEM_ARG_IN};
+      ctx->vmap.Set(id, repr);
     }
   }
 
   // visit all basic blocks
   Visit(func->bbs);
+
+  if (ctx->peephole)
+    ctx->peephole->Run(mir);
+  mir.Finalize();
+  if (ctx->obj)
+    EncodeFunc(mir, ctx->emitter);
+  else
+    mir.Print(ctx->emitter);
 }
 
 // visit basic block
 void Visit(const koopa_raw_basic_block_t &bb) {
-  printf("visit bb\n");
-  // +1: remove the starting % of block name
-  cout << bb->name + 1 << ":" << endl;
+  TRACE(TRACE_BACKEND, TRACE_DEBUG, "visit bb %s", bb->name);
+  ctx->mir.SetBlock(ctx->reg_alloc.BlockId(bb) + 1);
   Visit(bb->insts);
 }
 
-// visit value
-repr_t Visit(const koopa_raw_value_t &value) {
-  if (vmap.count(value)) {
-    // do not use reference here, no need to change stored value
-    repr_t repr = vmap[value];
-    if (repr.is_reg) {
-      return repr;
-    } else {
-      // no reg binded but has addr in stack
-      assert(repr.addr != -1);
-      reg_t reg = reg_allocator.alloc();
-      cout << "  lw " << format_reg(reg.regid) << ", " << repr.addr << "(sp)" << endl;
-      repr.is_reg = true;
-      repr.addr = reg.regid;
-    }  // already has reg bound to value
-    return repr;
+/**
+ * @brief get an operand into a register
+ *
+ * @param scratch where an integer or a spilled value is loaded
+ * @return int the register holding the operand
+ */
+static int Use(koopa_raw_value_t value, int scratch) {
+  if (value->kind.tag == KOOPA_RVT_INTEGER) {
+    // rematerialized at every use
+    int32_t val = value->kind.data.integer.value;
+    if (val == 0)
+      return REG_X0;
+    ctx->mir.Li(scratch, val);
+    return scratch;
   }
+  int id = ctx->vmap.Index(value);
+  assert(ctx->vmap.Known(id));
+  const repr_t &repr = ctx->vmap.Get(id);
+  if (repr.is_reg)
+    return repr.addr;
+  ctx->mir.Lw(scratch, repr.base, repr.addr);
+  return scratch;
+}
+
+// register to compute a result in, t6 for a spilled one (see Def)
+static int DefReg(const repr_t &repr) {
+  return repr.is_reg ? repr.addr : REG_T6;
+}
 
-  printf("visit new value\n");
+// store a spilled result computed in t6
+static void Def(const repr_t &repr) {
+  if (!repr.is_reg)
+    ctx->mir.Sw(REG_T6, repr.base, repr.addr);
+}
+
+static int Block(koopa_raw_basic_block_t bb) {
+  return ctx->reg_alloc.BlockId(bb) + 1;  // after the prologue
+}
+
+// visit value (an instruction)
+void Visit(const koopa_raw_value_t &value) {
+  TRACE(TRACE_BACKEND, TRACE_VERBOSE, "visit value");
   const auto &kind = value->kind;
-  repr_t repr = {false, -1};
-  bool has_ret;
+  int id = ctx->vmap.Index(value);
   switch (kind.tag) {
     case KOOPA_RVT_RETURN:
-      cout << "\n  # ret" << endl;
       Visit(kind.data.ret);
-      reg_allocator.free();
-      break;
-    case KOOPA_RVT_INTEGER:
-      repr = Visit(kind.data.integer);
-      // do not save ! do not clear reg!
       break;
     case KOOPA_RVT_BINARY:
-      cout << "\n  # binary" << endl;
-      repr = Visit(kind.data.binary);
-      assert(!repr.is_reg);
-      vmap[value] = repr;
-      reg_allocator.free();
+      if (ctx->vmap.Known(id))  // result used
+        Visit(kind.data.binary, id);
       break;
     case KOOPA_RVT_ALLOC:
-      cout << "\n  # alloc" << endl;
-      repr.addr = stack.get_top();
-      stack.inc_top(4);
-      vmap[value] = repr;
-      reg_allocator.free();
+      ctx->vmap.Set(id, {false, ctx->mir.NewSlot()});
       break;
     case KOOPA_RVT_LOAD:
-      cout << "\n  # load" << endl;
-      repr = Visit(kind.data.load);
-      assert(!repr.is_reg);
-      vmap[value] = repr;
-      reg_allocator.free();
+      if (ctx->vmap.Known(id))
+        Visit(kind.data.load, id);
       break;
     case KOOPA_RVT_STORE:
-      cout << "\n  # store" << endl;
       Visit(kind.data.store);
-      reg_allocator.free();
       break;
     case KOOPA_RVT_BRANCH:
       Visit(kind.data.branch);
-      reg_allocator.free();
       break;
     case KOOPA_RVT_JUMP:
       Visit(kind.data.jump);
-      reg_allocator.free();
       break;
     case KOOPA_RVT_CALL:
-      has_ret = value->ty->tag != KOOPA_RTT_UNIT;
-      repr = Visit(kind.data.call, has_ret);
-      vmap[value] = repr;  // todo actually, if has_ret=false, won't be used anymore
-      reg_allocator.free();
+      Visit(kind.data.call, id);
       break;
     case KOOPA_RVT_FUNC_ARG_REF:
       // already handle all func args in func def
@@ -359,203 +209,274 @@ repr_t Visit(const koopa_raw_value_t &value) {
       break;
     default:
       // 其他类型暂时遇不到
-      printf("unhandled value kind %d\n", kind.tag);
+      fprintf(stderr, "unhandled value kind %d\n", kind.tag);
       assert(false);
   }
-  // reg_allocator.free();  // todo is it ok? fuck! not ok!
-  return repr;
 }
 
-// visit return
+// visit return, the epilogue is added by MirFunc::Finalize
 void Visit(const koopa_raw_return_t &ret) {
   koopa_raw_value_t retv = ret.value;
   if (retv) {  // not void ret
-    repr_t repr = Visit(retv);
-    assert(repr.is_reg);
-    if (repr.addr != 7) {
-      cout << "  mv a0" << ", " << format_reg(repr.addr) << endl;
-    }
+    int reg = Use(retv, REG_A0);
+    if (reg != REG_A0)
+      ctx->mir.Mv(REG_A0, reg);
   }
-
-  // load ra from sp
-  if (ra_addr > 0) {  // todo
-    cout << "  lw ra, " << ra_addr << "(sp)" << endl;
-  }
-
-  // modify stack pointer
-  int stack_size = stack.get_size();
-  if (stack_size) {
-    if (stack_size <= 2047)
-      cout << "  addi sp, sp, " << stack_size << endl;
-    else {
-      // too big stack size
-      cout << "  li t0, " << stack_size << endl;
-      cout << "  addi sp, sp, t0" << endl;
-    }
-  }
-
-  cout << "  ret" << endl;
-}
-
-// visit integer
-repr_t Visit(const koopa_raw_integer_t &integer) {
-  printf("visit integer\n");
-  repr_t repr = {true, -1};
-
-  if (integer.value == 0) {
-    repr.addr = REGNUM;  // x0
-    return repr;
-  }
-  reg_t reg = reg_allocator.alloc();  // only interger won't occupy
-  repr.addr = reg.regid;
-  cout << "  li " << format_reg(repr.addr) << ", " << integer.value << endl;
-  
-  return repr;
+  ctx->mir.Ret();
 }
 
 // visit binary expression
-repr_t Visit(const koopa_raw_binary_t &binary) {
-  printf("visit binary\n");
-  koopa_raw_binary_op_t op = binary.op;
-  // assume: only int will assign new reg when Visit(koopa_value)
-  repr_t left = Visit(binary.lhs);
-  repr_t right = Visit(binary.rhs);
-  repr_t result = {true, reg_allocator.alloc().regid};
-
-  string op_str;
-  // load left
-  if (!left.is_reg) {
-    reg_t reg = reg_allocator.alloc();
-    cout << "  lw " << format_reg(reg.regid) << ", " << left.addr << "(sp)" << endl;
-    left.is_reg = true;
-    left.addr = reg.regid;
+void Visit(const koopa_raw_binary_t &binary, int id) {
+  TRACE(TRACE_BACKEND, TRACE_VERBOSE, "visit binary");
+  MirFunc &mir = ctx->mir;
+  repr_t result = ctx->vmap.Get(id);
+
+  // add / sub of an integer that fits an immediate: addi, once locals are
+  // promoted (Mem2Reg) their constants are operands everywhere
+  koopa_raw_value_t other = nullptr;
+  int32_t val = 0;
+  auto fold = [&](koopa_raw_value_t integer, koopa_raw_value_t value, int sign) {
+    if (other || integer->kind.tag != KOOPA_RVT_INTEGER)
+      return;
+    int64_t imm = (int64_t)sign * integer->kind.data.integer.value;
+    if (imm >= -2048 && imm <= 2047) {
+      other = value;
+      val = imm;
+    }
+  };
+  if (binary.op == KOOPA_RBO_ADD) {
+    fold(binary.rhs, binary.lhs, 1);
+    fold(binary.lhs, binary.rhs, 1);
+  } else if (binary.op == KOOPA_RBO_SUB) {
+    fold(binary.rhs, binary.lhs, -1);
   }
-  // load right
-  if (!right.is_reg) {
-    reg_t reg = reg_allocator.alloc();
-    cout << "  lw " << format_reg(reg.regid) << ", " << right.addr << "(sp)" << endl;
-    right.is_reg = true;
-    right.addr = reg.regid;
+  if (other) {
+    int dest = DefReg(result);
+    mir.OpImm(MIR_ADDI, dest, Use(other, REG_T5), val);
+    Def(result);
+    return;
   }
-  string left_reg = format_reg(left.addr);
-  string right_reg = format_reg(right.addr);
-  string result_reg = format_reg(result.addr);
-  
-  switch (op) {
-    case KOOPA_RBO_ADD:  // add
-    case KOOPA_RBO_SUB:  // sub
-    case KOOPA_RBO_MUL:  // mul
-    case KOOPA_RBO_DIV:  // div
-    case KOOPA_RBO_MOD:  // rem
-    case KOOPA_RBO_LT:   // slt
-    case KOOPA_RBO_AND:  // and
-    case KOOPA_RBO_OR:   // or
-    case KOOPA_RBO_GT:   // sgt
-      op_str = get_op_str(op);
-      cout << "  # " << op_str << endl;
-      cout << "  " << op_str << " " << result_reg << ", " << left_reg << ", " << right_reg << endl;
-      break;
-    case KOOPA_RBO_EQ:  // eq
-      cout << "  # eq" << endl;
-      cout << "  xor " << result_reg << ", " << left_reg << ", " << right_reg << endl;
-      cout << "  seqz " << result_reg << ", " << result_reg << endl;
+
+  int left = Use(binary.lhs, REG_T5);
+  int right = Use(binary.rhs, REG_T6);
+  int dest = DefReg(result);
+
+  switch (binary.op) {
+    case KOOPA_RBO_ADD: mir.Op(MIR_ADD, dest, left, right); break;
+    case KOOPA_RBO_SUB: mir.Op(MIR_SUB, dest, left, right); break;
+    case KOOPA_RBO_MUL: mir.Op(MIR_MUL, dest, left, right); break;
+    case KOOPA_RBO_DIV: mir.Op(MIR_DIV, dest, left, right); break;
+    case KOOPA_RBO_MOD: mir.Op(MIR_REM, dest, left, right); break;
+    case KOOPA_RBO_LT: mir.Op(MIR_SLT, dest, left, right); break;
+    case KOOPA_RBO_GT: mir.Op(MIR_SGT, dest, left, right); break;
+    case KOOPA_RBO_AND: mir.Op(MIR_AND, dest, left, right); break;
+    case KOOPA_RBO_OR: mir.Op(MIR_OR, dest, left, right); break;
+    case KOOPA_RBO_EQ:
+      mir.Op(MIR_XOR, dest, left, right);
+      mir.Op(MIR_SEQZ, dest, dest);
       break;
-    case KOOPA_RBO_NOT_EQ:  // neq
-      cout << "  xor " << result_reg << ", " << left_reg << ", " << right_reg << endl;
-      cout << "  snez " << result_reg << ", " << result_reg << endl;
+    case KOOPA_RBO_NOT_EQ:
+      mir.Op(MIR_XOR, dest, left, right);
+      mir.Op(MIR_SNEZ, dest, dest);
       break;
-    case KOOPA_RBO_LE:  // le
-      cout << "  sgt " << result_reg << ", " << left_reg << ", " << right_reg << endl;
-      cout << "  xori " << result_reg << ", " << result_reg << ", 1" << endl; 
+    case KOOPA_RBO_LE:
+      mir.Op(MIR_SGT, dest, left, right);
+      mir.OpImm(MIR_XORI, dest, dest, 1);
       break;
-    case KOOPA_RBO_GE:  // ge
-      cout << "  slt " << result_reg << ", " << left_reg << ", " << right_reg << endl;
-      cout << "  xori " << result_reg << ", " << result_reg << ", 1" << endl; 
+    case KOOPA_RBO_GE:
+      mir.Op(MIR_SLT, dest, left, right);
+      mir.OpImm(MIR_XORI, dest, dest, 1);
       break;
     default:
       assert(false);
   }
-
-  result.is_reg = false;
-  result.addr = stack.get_top();
-  stack.inc_top(4);
-  cout << "  sw " << result_reg << ", " << result.addr << "(sp)" << endl;
-
-  return result;
+  Def(result);
 }
 
 // load value from src
-repr_t Visit(const koopa_raw_load_t &load) {
-  printf("visit load\n");
+void Visit(const koopa_raw_load_t &load, int id) {
+  TRACE(TRACE_BACKEND, TRACE_VERBOSE, "visit load");
   koopa_raw_value_t src = load.src;
-  // save the load value in reg, ready to return
-  repr_t src_repr = Visit(src);
-  
-  assert(src_repr.is_reg);
-  string src_reg_name = format_reg(src_repr.addr);
-
-  // store the reg content into stack
-  repr_t dest = {false, stack.get_top()};
-  stack.inc_top(4);
-  cout << "  sw " << src_reg_name << ", " << dest.addr << "(sp)" << endl;
-
-  return dest;
+  int src_id = ctx->vmap.Index(src);
+  assert(src->kind.tag == KOOPA_RVT_ALLOC && ctx->vmap.Known(src_id));
+  const repr_t &src_repr = ctx->vmap.Get(src_id);
+  repr_t dest = ctx->vmap.Get(id);
+  ctx->mir.Lw(DefReg(dest), src_repr.base, src_repr.addr);
+  Def(dest);
 }
 
 void Visit(const koopa_raw_store_t &store) {
-  repr_t repr = Visit(store.value);
   koopa_raw_value_t dest = store.dest;
-  assert(vmap.count(dest));
-  repr_t dest_repr = vmap[dest];
+  int dest_id = ctx->vmap.Index(dest);
+  assert(ctx->vmap.Known(dest_id));
+  repr_t dest_repr = ctx->vmap.Get(dest_id);
   assert(!dest_repr.is_reg);
-
-  assert(repr.is_reg);
-  string reg_name = format_reg(repr.addr);
-  cout << "  sw " << reg_name << ", " << dest_repr.addr << "(sp)" << endl;
+  ctx->mir.Sw(Use(store.value, REG_T6), dest_repr.base, dest_repr.addr);
 }
 
 void Visit(const koopa_raw_branch_t &branch) {
-  string label_true = branch.true_bb->name + 1;
-  string label_false = branch.false_bb->name + 1;
-  repr_t cond_repr = Visit(branch.cond);
-  assert(cond_repr.is_reg);
-  cout << "  bnez " << format_reg(cond_repr.addr) << ", " << label_true << endl;
-  cout << "  j " << label_false << endl;
+  // Mem2Reg gives an edge with args a block of its own
+  assert(!branch.true_args.len && !branch.false_args.len);
+  ctx->mir.Bnez(Use(branch.cond, REG_T6), Block(branch.true_bb));
+  ctx->mir.J(Block(branch.false_bb));
+}
+
+// where a jump arg is, to tell which moves touch the same place: a
+// register, or a slot after them, -1 for what no move writes (the frame of
+// the caller)
+static int Place(const repr_t &repr) {
+  if (repr.is_reg)
+    return repr.addr;
+  return repr.base == MEM_SLOT ? REGNUM + repr.addr : -1;
+}
+
+// copy between registers and the stack, t5 for a slot to a slot
+static void Copy(const repr_t &dest, const repr_t &src) {
+  MirFunc &mir = ctx->mir;
+  if (dest.is_reg && src.is_reg) {
+    mir.Mv(dest.addr, src.addr);
+  } else if (dest.is_reg) {
+    mir.Lw(dest.addr, src.base, src.addr);
+  } else if (src.is_reg) {
+    mir.Sw(src.addr, dest.base, dest.addr);
+  } else {
+    mir.Lw(REG_T5, src.base, src.addr);
+    mir.Sw(REG_T5, dest.base, dest.addr);
+  }
 }
 
 void Visit(const koopa_raw_jump_t &jump) {
-  string label_target = jump.target->name + 1;
-  cout << "  j " << label_target << endl;
+  MirFunc &mir = ctx->mir;
+  // args go to the params of the target at once, like the args of a call:
+  // a move waits while its target is still the source of another one, a
+  // cycle is broken by a slot of its own (Finalize may need t6 for a sw)
+  struct move_t {
+    repr_t dest;
+    repr_t src;
+  };
+  vector<move_t> moves;
+  vector<pair<repr_t, koopa_raw_value_t>> late;  // integers and args in the frame of the caller
+  auto target = jump.target;
+  for (size_t i = 0; i < jump.args.len; ++i) {
+    int param = ctx->vmap.Index(reinterpret_cast<koopa_raw_value_t>(target->params.buffer[i]));
+    if (!ctx->vmap.Known(param))
+      continue;  // unused
+    const repr_t &dest = ctx->vmap.Get(param);
+    koopa_raw_value_t arg = reinterpret_cast<koopa_raw_value_t>(jump.args.buffer[i]);
+    int arg_id = ctx->vmap.Index(arg);
+    if (arg_id < 0 || Place(ctx->vmap.Get(arg_id)) < 0)
+      late.push_back({dest, arg});
+    else if (Place(ctx->vmap.Get(arg_id)) != Place(dest))
+      moves.push_back({dest, ctx->vmap.Get(arg_id)});
+  }
+
+  int temp_slot = -1;
+  while (!moves.empty()) {
+    bool moved = false;
+    for (size_t i = 0; i < moves.size();) {
+      bool blocked = false;
+      for (size_t j = 0; j < moves.size() && !blocked; ++j)
+        blocked = j != i && Place(moves[j].src) == Place(moves[i].dest);
+      if (blocked) {
+        ++i;
+        continue;
+      }
+      Copy(moves[i].dest, moves[i].src);
+      moves[i] = moves.back();
+      moves.pop_back();
+      moved = true;
+    }
+    if (!moved) {
+      // every move waits: a cycle, save the target of one
+      if (temp_slot < 0)
+        temp_slot = mir.NewSlot();
+      repr_t temp = {false, temp_slot};
+      int place = Place(moves[0].dest);
+      Copy(temp, moves[0].dest);
+      for (auto &move : moves) {
+        if (Place(move.src) == place)
+          move.src = temp;
+      }
+    }
+  }
+  for (auto &move : late) {
+    const repr_t &dest = move.first;
+    int reg = Use(move.second, dest.is_reg ? dest.addr : REG_T5);
+    if (!dest.is_reg)
+      mir.Sw(reg, dest.base, dest.addr);
+    else if (reg != dest.addr)
+      mir.Mv(dest.addr, reg);
+  }
+  mir.J(Block(target));
 }
 
-repr_t Visit(const koopa_raw_call_t &call, bool has_ret) {
-  repr_t repr;
-  for (size_t i = 0; i < call.args.len; ++i) {
+void Visit(const koopa_raw_call_t &call, int id) {
+  MirFunc &mir = ctx->mir;
+  // args on stack first, they only read registers
+  for (size_t i = 8; i < call.args.len; ++i) {
     koopa_raw_value_t arg = reinterpret_cast<koopa_raw_value_t>(call.args.buffer[i]);
-    repr_t arg_repr = Visit(arg);
-    assert(arg_repr.is_reg);
-    int reg_id = arg_repr.addr;  // currently it is saved in arg_reg_id
-    if (i < 8) {
-      int reg_ai = 7 + i;  // target
-      // move to ax
-      if (reg_id != reg_ai) {
-        // todo unsafe assert here, better make sure reg_ai is available
-        reg_allocator.alloc(reg_ai);
-        cout << "  mv " << format_reg(reg_ai) << ", " << format_reg(reg_id) << endl;
+    mir.Sw(Use(arg, REG_T6), MEM_ARG_OUT, (i - 8) * 4);
+  }
+  if (call.args.len > 8 && (int)(call.args.len - 8) * 4 > mir.arg_out_size)
+    mir.arg_out_size = (call.args.len - 8) * 4;
+
+  // args in registers move to a0 ~ a7 at once: a move waits while its
+  // target is still the source of another one, a cycle is broken with t6.
+  // nothing else is in a register here, values live across the call are
+  // on the stack
+  int src[8];
+  int arg_num = call.args.len < 8 ? call.args.len : 8;
+  for (int i = 0; i < arg_num; ++i) {
+    koopa_raw_value_t arg = reinterpret_cast<koopa_raw_value_t>(call.args.buffer[i]);
+    int arg_id = ctx->vmap.Index(arg);
+    bool in_reg = arg_id >= 0 && ctx->vmap.Get(arg_id).is_reg;
+    src[i] = in_reg ? ctx->vmap.Get(arg_id).addr : -1;
+  }
+  for (bool pending = true; pending;) {
+    pending = false;
+    bool moved = false;
+    for (int i = 0; i < arg_num; ++i) {
+      if (src[i] < 0 || src[i] == REG_A0 + i)
+        continue;
+      bool blocked = false;
+      for (int j = 0; j < arg_num; ++j)
+        blocked |= j != i && src[j] == REG_A0 + i;
+      if (blocked) {
+        pending = true;
+        continue;
       }
-    } else {
-      int addr = (i - 8) * 4;  // it is really comfortable!
-      cout << "  sw " << format_reg(reg_id) << ", " << addr << "(sp)" << endl;
+      mir.Mv(REG_A0 + i, src[i]);
+      src[i] = REG_A0 + i;
+      moved = true;
+    }
+    if (pending && !moved) {
+      // a cycle, free the target of the first waiting move
+      int i = 0;
+      while (src[i] < 0 || src[i] == REG_A0 + i)
+        ++i;
+      mir.Mv(REG_T6, REG_A0 + i);
+      for (int j = 0; j < arg_num; ++j)
+        if (src[j] == REG_A0 + i)
+          src[j] = REG_T6;
     }
-    reg_allocator.free(reg_id);
   }
-  cout << "  call " << call.callee->name + 1 << endl;
-  
-  // save a0
-  if (has_ret) {
-    repr = {false, stack.get_top()};
-    stack.inc_top(4);
-    cout << "  sw a0" << ", " << repr.addr << "(sp)" << endl;
+  // integers and spilled args straight into their registers
+  for (int i = 0; i < arg_num; ++i) {
+    if (src[i] >= 0)
+      continue;
+    koopa_raw_value_t arg = reinterpret_cast<koopa_raw_value_t>(call.args.buffer[i]);
+    int reg = Use(arg, REG_A0 + i);
+    if (reg != REG_A0 + i)
+      mir.Mv(REG_A0 + i, reg);
   }
-  return repr;
-}
\ No newline at end of file
+  mir.Call(call.callee->name + 1);
+
+  // result in a0, if used
+  if (ctx->vmap.Known(id)) {
+    repr_t repr = ctx->vmap.Get(id);
+    if (!repr.is_reg)
+      mir.Sw(REG_A0, repr.base, repr.addr);
+    else if (repr.addr != REG_A0)
+      mir.Mv(repr.addr, REG_A0);
+  }
+}
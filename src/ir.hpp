@@ -3,24 +3,70 @@
 
 #include <string>
 #include <cassert>
-#include <iostream>
+#include <cstdint>
+#include <vector>
 #include <koopa.h>
-#define REGNUM 15
+#include <mir.hpp>
+#include <trace.hpp>
+
+using namespace std;
 
 // a struct to save the return of a koopa value
+// a register, or a stack offset from base
 typedef struct {
   bool is_reg;
   int addr;
+  mir_base_t base = MEM_SLOT;
 } repr_t;
 
-// register struct
-typedef struct {
-  int regid;
-  bool occupied;
-  // koopa_raw_value_t target;
-} reg_t;
+// must use a value map, so when referred to a value pointer
+// it won't be dump twice
+// the params of a function, then the params and instructions of every
+// block are numbered once when it is entered (Reset), an open addressing
+// table gives the number of a value and the locations live in a flat array
+// indexed by it
+class ValueMap {
+ private:
+  vector<koopa_raw_value_t> keys;  // size is a power of 2, null is empty
+  vector<int> ids;
+  vector<repr_t> reprs;
+  vector<bool> known;  // repr is set
+  vector<koopa_raw_value_t> values;  // by number
+
+  static size_t Hash(koopa_raw_value_t value) {
+    return (reinterpret_cast<uintptr_t>(value) >> 4) * 0x9e3779b97f4a7c15ull;
+  }
+
+  void Insert(koopa_raw_value_t value);
+
+ public:
+  ValueMap() : keys(16, nullptr), ids(16) {}  // empty before the first function
+
+  // number the values of func, all reprs are forgotten
+  void Reset(const koopa_raw_function_t &func);
+
+  // -1 for a value not in the function (integers, globals)
+  int Index(koopa_raw_value_t value) const {
+    size_t mask = keys.size() - 1;
+    for (size_t i = Hash(value) & mask;; i = (i + 1) & mask) {
+      if (keys[i] == value)
+        return ids[i];
+      if (!keys[i])
+        return -1;
+    }
+  }
+
+  int size() const { return reprs.size(); }
+  koopa_raw_value_t Value(int id) const { return values[id]; }
+  bool Known(int id) const { return id >= 0 && known[id]; }
+  const repr_t& Get(int id) const { return reprs[id]; }
+  void Set(int id, const repr_t &repr) {
+    reprs[id] = repr;
+    known[id] = true;
+  }
+};
 
-void gen_riscv(std::string koopa_str);
+void gen_riscv(const koopa_raw_program_t &raw);
 void Visit(const koopa_raw_program_t &program);
 void Visit(const koopa_raw_slice_t &slice);
 void Visit(const koopa_raw_function_t &func);
@@ -29,11 +75,10 @@ void Visit(const koopa_raw_return_t &ret);
 void Visit(const koopa_raw_store_t &store);
 void Visit(const koopa_raw_branch_t &branch);
 void Visit(const koopa_raw_jump_t &jump);
-// return reg name
-repr_t Visit(const koopa_raw_value_t &value);
-repr_t Visit(const koopa_raw_integer_t &integer);
-repr_t Visit(const koopa_raw_binary_t &binary);
-repr_t Visit(const koopa_raw_load_t &load);
-repr_t Visit(const koopa_raw_call_t &call, bool has_ret);
+// an instruction, its result goes to its repr in ctx->vmap
+void Visit(const koopa_raw_value_t &value);
+void Visit(const koopa_raw_binary_t &binary, int id);
+void Visit(const koopa_raw_load_t &load, int id);
+void Visit(const koopa_raw_call_t &call, int id);
 
 #endif
\ No newline at end of file
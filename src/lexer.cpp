@@ -0,0 +1,328 @@
+#include <lexer.hpp>
+
+#include <context.hpp>
+#include <trace.hpp>
+#include "sysy.tab.hpp"
+
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// flex scanner of sysy.l (its yylex is renamed by YY_DECL)
+extern int FlexLex(YYSTYPE *lval, yyscan_t scanner);
+extern int yylex_init(yyscan_t *scanner);
+extern int yylex_destroy(yyscan_t scanner);
+struct yy_buffer_state;
+extern yy_buffer_state *yy_scan_bytes(const char *bytes, int len, yyscan_t scanner);
+
+// the parser's lexer
+int yylex(YYSTYPE *lval, token_span_t *lloc, Lexer *lexer) {
+  return lexer->Lex(lval, lloc);
+}
+
+// ==================== MappedFile ==================== //
+
+MappedFile::~MappedFile() {
+  if (mapped)
+    munmap(const_cast<char*>(data_), size_);
+}
+
+bool MappedFile::Open(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+
+  size_ = st.st_size;
+  if (size_ == 0) {
+    // mmap refuses empty files
+    data_ = "";
+  } else {
+    void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    madvise(p, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(p);
+    mapped = true;
+  }
+  close(fd);
+  return true;
+}
+
+// ==================== byte classes ==================== //
+
+// every class gives a scalar test and a mask of the member bytes of a
+// SIMD block, the scans below stop at the first byte outside the class
+
+#if defined(__SSE2__)
+static inline __m128i InRange(__m128i v, char lo, char hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                       _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), v));
+}
+static inline __m128i Eq(__m128i v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+static inline __m128i Or(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+static inline __m128i Lower(__m128i v) { return _mm_or_si128(v, _mm_set1_epi8(0x20)); }
+static inline unsigned Bits(__m128i m) { return _mm_movemask_epi8(m); }
+#endif
+
+#if defined(__AVX2__)
+static inline __m256i InRange(__m256i v, char lo, char hi) {
+  return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+static inline __m256i Eq(__m256i v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+static inline __m256i Or(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+static inline __m256i Lower(__m256i v) { return _mm256_or_si256(v, _mm256_set1_epi8(0x20)); }
+static inline unsigned Bits(__m256i m) { return _mm256_movemask_epi8(m); }
+#endif
+
+// [ \t\n\r]
+struct SpaceClass {
+  static bool Test(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+  template <class V> static unsigned Mask(V v) {
+    return Bits(Or(Or(Eq(v, ' '), Eq(v, '\t')), Or(Eq(v, '\n'), Eq(v, '\r'))));
+  }
+};
+
+// [a-zA-Z0-9_]
+struct IdentClass {
+  static bool Test(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+  }
+  template <class V> static unsigned Mask(V v) {
+    return Bits(Or(Or(InRange(Lower(v), 'a', 'z'), InRange(v, '0', '9')), Eq(v, '_')));
+  }
+};
+
+// [0-9]
+struct DigitClass {
+  static bool Test(char c) { return c >= '0' && c <= '9'; }
+  template <class V> static unsigned Mask(V v) { return Bits(InRange(v, '0', '9')); }
+};
+
+// [0-7]
+struct OctalClass {
+  static bool Test(char c) { return c >= '0' && c <= '7'; }
+  template <class V> static unsigned Mask(V v) { return Bits(InRange(v, '0', '7')); }
+};
+
+// [0-9a-fA-F]
+struct HexClass {
+  static bool Test(char c) { return DigitClass::Test(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f'); }
+  template <class V> static unsigned Mask(V v) {
+    return Bits(Or(InRange(v, '0', '9'), InRange(Lower(v), 'a', 'f')));
+  }
+};
+
+// [^\n], body of a line comment
+struct LineClass {
+  static bool Test(char c) { return c != '\n'; }
+  template <class V> static unsigned Mask(V v) { return ~Bits(Eq(v, '\n')); }
+};
+
+// [^*], body of a block comment
+struct StarClass {
+  static bool Test(char c) { return c != '*'; }
+  template <class V> static unsigned Mask(V v) { return ~Bits(Eq(v, '*')); }
+};
+
+// skip the bytes of class C from p, loads never cross end
+template <class C>
+static inline const char* Skip(const char *p, const char *end) {
+#if defined(__AVX2__)
+  while (end - p >= 32) {
+    unsigned out = ~C::Mask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    if (out)
+      return p + __builtin_ctz(out);
+    p += 32;
+  }
+#endif
+#if defined(__SSE2__)
+  while (end - p >= 16) {
+    unsigned out = ~C::Mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) & 0xffff;
+    if (out)
+      return p + __builtin_ctz(out);
+    p += 16;
+  }
+#endif
+  while (p < end && C::Test(*p))
+    p++;
+  return p;
+}
+
+// ==================== keywords ==================== //
+
+struct keyword_t {
+  const char *word;
+  size_t len;
+  int token;
+};
+
+// perfect hash of the 9 keywords: (first * 5 + last + len) % 16
+static const keyword_t keywords[16] = {
+  {"", 0, 0}, {"", 0, 0}, {"else", 4, ELSE}, {"", 0, 0},
+  {"int", 3, INT}, {"if", 2, IF}, {"void", 4, VOID}, {"", 0, 0},
+  {"const", 5, CONST}, {"", 0, 0}, {"break", 5, BREAK}, {"", 0, 0},
+  {"continue", 8, CONTINUE}, {"while", 5, WHILE}, {"return", 6, RETURN}, {"", 0, 0},
+};
+
+static inline int Keyword(const char *p, size_t len) {
+  unsigned h = ((unsigned char)p[0] * 5 + (unsigned char)p[len - 1] + len) & 15;
+  const keyword_t &kw = keywords[h];
+  if (kw.len == len && !memcmp(kw.word, p, len))
+    return kw.token;
+  return IDENT;
+}
+
+// strtol(text, nullptr, 0) of a number token, converted to int like sysy.l
+// does (overflow saturates at LONG_MAX)
+static int NumberValue(const char *p, const char *end, int base) {
+  unsigned long long value = 0;
+  for (; p < end; ++p) {
+    int digit = DigitClass::Test(*p) ? *p - '0' : (*p | 0x20) - 'a' + 10;
+    if (value > static_cast<unsigned long long>((LONG_MAX - digit) / base)) {
+      value = LONG_MAX;
+      break;
+    }
+    value = value * base + digit;
+  }
+  return static_cast<long>(value);
+}
+
+// ==================== Lexer ==================== //
+
+Lexer::Lexer(const char *src, size_t len, bool use_flex, vector<token_t> *tokens)
+    : cur(src), end(src + len), tokens(tokens) {
+  if (use_flex) {
+    assert(len <= INT_MAX);
+    yylex_init(&flex);
+    yy_scan_bytes(src, len, flex);
+  }
+}
+
+Lexer::~Lexer() {
+  if (flex)
+    yylex_destroy(flex);
+}
+
+int Lexer::Lex(YYSTYPE *lval, token_span_t *lloc) {
+  int kind = flex ? FlexLex(lval, flex) : FastLex(lval);
+  lloc->first = lloc->last = token_num++;
+  if (tokens) {
+    int value = 0;
+    if (kind == IDENT)
+      value = lval->sym_val;
+    else if (kind == INT_CONST)
+      value = lval->int_val;
+    else if (kind == RELOP || kind == EQOP)
+      value = lval->op_val;
+    tokens->push_back({kind, value});
+  }
+  return kind;
+}
+
+// mirrors the rules of sysy.l: longest match, the earlier rule on ties
+int Lexer::FastLex(YYSTYPE *lval) {
+  for (;;) {
+    cur = Skip<SpaceClass>(cur, end);
+    if (end - cur < 2 || cur[0] != '/')
+      break;
+    if (cur[1] == '/') {
+      // "//".*$ needs the newline, a comment at EOF without one is just '/'
+      const char *nl = Skip<LineClass>(cur + 2, end);
+      if (nl == end)
+        break;
+      cur = nl;
+    } else if (cur[1] == '*') {
+      // up to the first "*/", unterminated comments are just '/'
+      const char *p = cur + 2;
+      for (;;) {
+        p = Skip<StarClass>(p, end);
+        while (p < end && *p == '*')
+          p++;
+        if (p == end || *p == '/')
+          break;
+      }
+      if (p == end)
+        break;
+      cur = p + 1;
+    } else {
+      break;
+    }
+  }
+  if (cur == end)
+    return 0;
+
+  const char *begin = cur;
+  char c = *cur;
+
+  // identifier or keyword
+  if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+    cur = Skip<IdentClass>(cur + 1, end);
+    int token = Keyword(begin, cur - begin);
+    if (token == IDENT)
+      lval->sym_val = ctx->interner.Intern(string_view(begin, cur - begin));
+    return token;
+  }
+
+  // numbers
+  if (c >= '1' && c <= '9') {
+    cur = Skip<DigitClass>(cur + 1, end);
+    lval->int_val = NumberValue(begin, cur, 10);
+    return INT_CONST;
+  }
+  if (c == '0') {
+    if (end - cur > 2 && (cur[1] | 0x20) == 'x' && HexClass::Test(cur[2])) {
+      cur = Skip<HexClass>(cur + 2, end);
+      lval->int_val = NumberValue(begin + 2, cur, 16);
+    } else {
+      cur = Skip<OctalClass>(cur + 1, end);
+      lval->int_val = NumberValue(begin + 1, cur, 8);
+    }
+    return INT_CONST;
+  }
+
+  // operators
+  bool eq_next = end - cur > 1 && cur[1] == '=';
+  switch (c) {
+    case '<':
+    case '>':
+      lval->op_val = c == '<' ? (eq_next ? OP_LE : OP_LT) : (eq_next ? OP_GE : OP_GT);
+      cur += eq_next ? 2 : 1;
+      TRACE(TRACE_LEX, TRACE_VERBOSE, "RelOP %.*s", (int)(cur - begin), begin);
+      return RELOP;
+    case '=':
+    case '!':
+      if (!eq_next)
+        break;
+      lval->op_val = c == '=' ? OP_EQ : OP_NE;
+      cur += 2;
+      TRACE(TRACE_LEX, TRACE_VERBOSE, "EqOP %.*s", (int)(cur - begin), begin);
+      return EQOP;
+    case '&':
+    case '|':
+      if (end - cur < 2 || cur[1] != c)
+        break;
+      cur += 2;
+      return c == '&' ? ANDOP : OROP;
+  }
+  cur++;
+  return c;
+}
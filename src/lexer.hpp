@@ -0,0 +1,76 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+union YYSTYPE;
+typedef void *yyscan_t;
+
+// location of a grammar symbol: the indices of its first and last token
+struct token_span_t {
+  int first;
+  int last;
+
+  token_span_t() = default;
+  // bison starts the lookahead location of a trivial type from
+  // { 1, 1, 1, 1 } (line and column of both ends)
+  token_span_t(int first, int last, int = 0, int = 0) : first(first), last(last) {}
+};
+// trivially copyable: bison may copy the location stack with memcpy, so
+// the parser stack grows on demand instead of starting at full depth
+#define YYLTYPE_IS_TRIVIAL 1
+
+// a recorded token: its kind and value (symbol id, number or operator)
+struct token_t {
+  int kind;
+  int value;
+};
+
+// read-only mapping of a whole source file
+class MappedFile {
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped = false;
+
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  bool Open(const char *path);
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+};
+
+// token source of the parser, over a source held in memory
+// - default: hand written scanner, whitespace / comments / identifiers /
+//   numbers are scanned 16 (SSE2) or 32 (AVX2) bytes at a time, keywords
+//   are found by a perfect hash
+// - use_flex: the flex scanner of sysy.l, the reference of the above
+// both return exactly the same tokens (make lexer-check)
+// tokens are numbered from 0, and recorded into tokens when it is given
+class Lexer {
+ private:
+  const char *cur;
+  const char *end;
+  yyscan_t flex = nullptr;
+  int token_num = 0;
+  vector<token_t> *tokens;
+
+  int FastLex(YYSTYPE *lval);
+
+ public:
+  Lexer(const char *src, size_t len, bool use_flex = false, vector<token_t> *tokens = nullptr);
+  Lexer(const Lexer&) = delete;
+  Lexer& operator=(const Lexer&) = delete;
+  ~Lexer();
+
+  int Lex(YYSTYPE *lval, token_span_t *lloc);
+};
+
+#endif
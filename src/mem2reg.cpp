@@ -0,0 +1,417 @@
+#include <mem2reg.hpp>
+
+#include <memstat.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <utility>
+
+void Mem2Reg::Run(const koopa_raw_program_t &program) {
+  MemScope mem(MEM_IR);
+  for (size_t i = 0; i < program.funcs.len; ++i) {
+    auto func = (func_t*)program.funcs.buffer[i];
+    if (!func->bbs.len)
+      continue;
+    Graph(func);
+    Dominators();
+    Place();
+    Rename(func);
+  }
+}
+
+// successors of a block by its terminator
+static void Successors(koopa_raw_basic_block_t bb, vector<koopa_raw_basic_block_t> &out) {
+  out.clear();
+  assert(bb->insts.len);
+  auto last = (koopa_raw_value_t)bb->insts.buffer[bb->insts.len - 1];
+  if (last->kind.tag == KOOPA_RVT_BRANCH) {
+    out.push_back(last->kind.data.branch.true_bb);
+    out.push_back(last->kind.data.branch.false_bb);
+  } else if (last->kind.tag == KOOPA_RVT_JUMP) {
+    out.push_back(last->kind.data.jump.target);
+  }
+}
+
+/**
+ * @brief number the blocks, link them and order the reachable ones
+ * (reverse postorder from the entry)
+ */
+void Mem2Reg::Graph(func_t *func) {
+  size_t n = func->bbs.len;
+  bbs.resize(n);
+  bb_ids.clear();
+  for (size_t b = 0; b < n; ++b) {
+    bbs[b] = (bb_t*)func->bbs.buffer[b];
+    bb_ids[bbs[b]] = b;
+  }
+  succs.assign(n, {});
+  preds.assign(n, {});
+  vector<koopa_raw_basic_block_t> targets;
+  for (size_t b = 0; b < n; ++b) {
+    Successors(bbs[b], targets);
+    for (auto target : targets)
+      succs[b].push_back(bb_ids.at(target));
+  }
+
+  // postorder by a depth first walk, (block, next successor) on the stack
+  rpo.clear();
+  rpo_index.assign(n, -1);
+  vector<bool> visited(n, false);
+  vector<pair<int, size_t>> walk = {{0, 0}};
+  visited[0] = true;
+  while (!walk.empty()) {
+    auto &top = walk.back();
+    int b = top.first;
+    if (top.second < succs[b].size()) {
+      int s = succs[b][top.second++];
+      if (!visited[s]) {
+        visited[s] = true;
+        walk.push_back({s, 0});
+      }
+    } else {
+      rpo.push_back(b);
+      walk.pop_back();
+    }
+  }
+  reverse(rpo.begin(), rpo.end());
+  for (size_t i = 0; i < rpo.size(); ++i)
+    rpo_index[rpo[i]] = i;
+
+  for (int b : rpo) {
+    for (int s : succs[b])
+      preds[s].push_back(b);
+  }
+}
+
+/**
+ * @brief immediate dominators (Cooper, Harvey and Kennedy: iterate over
+ * the reverse postorder until nothing changes), then the dominance
+ * frontier of every reachable block
+ */
+void Mem2Reg::Dominators() {
+  size_t n = bbs.size();
+  idom.assign(n, -1);
+  idom[0] = 0;
+  auto intersect = [&](int a, int b) {
+    while (a != b) {
+      while (rpo_index[a] > rpo_index[b])
+        a = idom[a];
+      while (rpo_index[b] > rpo_index[a])
+        b = idom[b];
+    }
+    return a;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = 1; i < rpo.size(); ++i) {
+      int b = rpo[i];
+      int new_idom = -1;
+      for (int p : preds[b]) {
+        if (idom[p] < 0)
+          continue;
+        new_idom = new_idom < 0 ? p : intersect(p, new_idom);
+      }
+      if (idom[b] != new_idom) {
+        idom[b] = new_idom;
+        changed = true;
+      }
+    }
+  }
+
+  frontier.assign(n, {});
+  for (int b : rpo) {
+    if (preds[b].size() < 2)
+      continue;
+    for (int p : preds[b]) {
+      for (int runner = p; runner != idom[b]; runner = idom[runner]) {
+        if (!frontier[runner].empty() && frontier[runner].back() == b)
+          break;
+        frontier[runner].push_back(b);
+      }
+    }
+  }
+}
+
+/**
+ * @brief find the allocs to promote and give the blocks their params
+ */
+void Mem2Reg::Place() {
+  size_t n = bbs.size();
+  // in one pass, an alloc comes before its uses in reverse postorder:
+  // - an alloc used but as the src of a load or the dest of a store stays
+  // - the blocks storing every alloc, and the allocs some block loads
+  //   before it stores them: only those live into a block and need params
+  alloc_ids.clear();
+  load_num = 0;
+  vector<bool> escaped;
+  vector<vector<int>> defs;
+  vector<bool> live_in;
+  vector<int> stored;  // block storing it so far
+  auto find = [&](koopa_raw_value_t value) {
+    if (value->kind.tag != KOOPA_RVT_ALLOC)
+      return -1;
+    auto it = alloc_ids.find(value);
+    return it == alloc_ids.end() ? -1 : it->second;
+  };
+  auto use = [&](koopa_raw_value_t value) {
+    int a = find(value);
+    if (a >= 0)
+      escaped[a] = true;
+  };
+  auto use_all = [&](const koopa_raw_slice_t &values) {
+    for (size_t i = 0; i < values.len; ++i)
+      use((koopa_raw_value_t)values.buffer[i]);
+  };
+  for (int b : rpo) {
+    for (size_t i = 0; i < bbs[b]->insts.len; ++i) {
+      auto inst = (koopa_raw_value_t)bbs[b]->insts.buffer[i];
+      const auto &kind = inst->kind;
+      switch (kind.tag) {
+        case KOOPA_RVT_ALLOC:
+          if (inst->ty->data.pointer.base->tag == KOOPA_RTT_INT32) {
+            alloc_ids[inst] = escaped.size();
+            escaped.push_back(false);
+            defs.emplace_back();
+            live_in.push_back(false);
+            stored.push_back(-1);
+          }
+          break;
+        case KOOPA_RVT_LOAD: {
+          int a = find(kind.data.load.src);
+          if (a >= 0) {
+            load_num++;
+            if (stored[a] != b)
+              live_in[a] = true;
+          }
+          break;
+        }
+        case KOOPA_RVT_STORE: {
+          use(kind.data.store.value);
+          int a = find(kind.data.store.dest);
+          if (a >= 0 && stored[a] != b) {
+            stored[a] = b;
+            defs[a].push_back(b);
+          }
+          break;
+        }
+        case KOOPA_RVT_BINARY:
+          use(kind.data.binary.lhs);
+          use(kind.data.binary.rhs);
+          break;
+        case KOOPA_RVT_BRANCH:
+          use(kind.data.branch.cond);
+          use_all(kind.data.branch.true_args);
+          use_all(kind.data.branch.false_args);
+          break;
+        case KOOPA_RVT_JUMP:
+          use_all(kind.data.jump.args);
+          break;
+        case KOOPA_RVT_CALL:
+          use_all(kind.data.call.args);
+          break;
+        case KOOPA_RVT_RETURN:
+          if (kind.data.ret.value)
+            use(kind.data.ret.value);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+  alloc_num = escaped.size();
+  for (auto it = alloc_ids.begin(); it != alloc_ids.end();) {
+    if (escaped[it->second])
+      it = alloc_ids.erase(it);
+    else
+      ++it;
+  }
+
+  // params at the iterated dominance frontier of the stores
+  params.assign(n, {});
+  vector<int> has_param(n, -1), queued(n, -1);
+  vector<int> work;
+  for (size_t a = 0; a < alloc_num; ++a) {
+    if (escaped[a] || !live_in[a])
+      continue;
+    work = defs[a];
+    for (int b : work)
+      queued[b] = a;
+    while (!work.empty()) {
+      int b = work.back();
+      work.pop_back();
+      for (int d : frontier[b]) {
+        if (has_param[d] == (int)a)
+          continue;
+        has_param[d] = a;
+        params[d].push_back(a);
+        if (queued[d] != (int)a) {
+          queued[d] = a;
+          work.push_back(d);
+        }
+      }
+    }
+  }
+  for (int b : rpo) {
+    vector<const void*> values;
+    for (size_t k = 0; k < params[b].size(); ++k) {
+      value_t *param = builder.NewValue(&type_i32, KOOPA_RVT_BLOCK_ARG_REF);
+      param->kind.data.block_arg_ref.index = k;
+      values.push_back(param);
+    }
+    bbs[b]->params = builder.NewSlice(move(values), KOOPA_RSIK_VALUE);
+  }
+}
+
+/**
+ * @brief walk down the dominator tree: rewrite the uses of promoted loads,
+ * drop allocs, loads and stores, pass the args on jumps (splitting the
+ * edges of branches that need some) and lay the blocks out again
+ */
+void Mem2Reg::Rename(func_t *func) {
+  size_t n = bbs.size();
+  vector<vector<int>> children(n);
+  for (size_t i = 1; i < rpo.size(); ++i)
+    children[idom[rpo[i]]].push_back(rpo[i]);
+
+  unordered_map<koopa_raw_value_t, koopa_raw_value_t> loaded;  // promoted load -> its value
+  loaded.reserve(load_num);
+  auto resolve = [&](koopa_raw_value_t &value) {
+    if (value->kind.tag != KOOPA_RVT_LOAD)
+      return;
+    auto it = loaded.find(value);
+    if (it != loaded.end())
+      value = it->second;
+  };
+  auto resolve_all = [&](koopa_raw_slice_t &values) {
+    for (size_t i = 0; i < values.len; ++i)
+      resolve((koopa_raw_value_t&)values.buffer[i]);
+  };
+
+  // value of every alloc so far, what the blocks on the walk pushed
+  vector<vector<koopa_raw_value_t>> stacks(alloc_num);
+  vector<int> pushed;
+  value_t *zero = nullptr;
+  auto top = [&](int a) -> koopa_raw_value_t {
+    if (!stacks[a].empty())
+      return stacks[a].back();
+    if (!zero) {
+      zero = builder.NewValue(&type_i32, KOOPA_RVT_INTEGER);
+      zero->kind.data.integer.value = 0;
+    }
+    return zero;
+  };
+  auto args = [&](int target) {
+    vector<const void*> values;
+    for (int a : params[target])
+      values.push_back(top(a));
+    return builder.NewSlice(move(values), KOOPA_RSIK_VALUE);
+  };
+
+  vector<vector<const void*>> edges(n);  // split edges, placed after the branch
+  int edge_num = 0;
+  auto split = [&](int target) {
+    bb_t *edge = builder.GetBlock("%edge_" + to_string(edge_num++));
+    value_t *jump = builder.NewValue(&type_unit, KOOPA_RVT_JUMP);
+    jump->kind.data.jump.target = bbs[target];
+    jump->kind.data.jump.args = args(target);
+    edge->insts = builder.NewSlice({jump}, KOOPA_RSIK_VALUE);
+    return edge;
+  };
+
+  // (block, mark of pushed when entered), -1: not entered yet
+  vector<pair<int, int>> walk = {{0, -1}};
+  vector<const void*> insts;
+  while (!walk.empty()) {
+    int b = walk.back().first, mark = walk.back().second;
+    if (mark >= 0) {
+      while ((int)pushed.size() > mark) {
+        stacks[pushed.back()].pop_back();
+        pushed.pop_back();
+      }
+      walk.pop_back();
+      continue;
+    }
+    walk.back().second = pushed.size();
+
+    for (size_t k = 0; k < params[b].size(); ++k) {
+      stacks[params[b][k]].push_back((koopa_raw_value_t)bbs[b]->params.buffer[k]);
+      pushed.push_back(params[b][k]);
+    }
+    insts.clear();
+    for (size_t i = 0; i < bbs[b]->insts.len; ++i) {
+      auto inst = (value_t*)bbs[b]->insts.buffer[i];
+      auto &kind = inst->kind;
+      switch (kind.tag) {
+        case KOOPA_RVT_ALLOC:
+          if (alloc_ids.count(inst))
+            continue;
+          break;
+        case KOOPA_RVT_LOAD: {
+          auto it = alloc_ids.find(kind.data.load.src);
+          if (it != alloc_ids.end()) {
+            loaded[inst] = top(it->second);
+            continue;
+          }
+          break;
+        }
+        case KOOPA_RVT_STORE: {
+          resolve(kind.data.store.value);
+          auto it = alloc_ids.find(kind.data.store.dest);
+          if (it != alloc_ids.end()) {
+            stacks[it->second].push_back(kind.data.store.value);
+            pushed.push_back(it->second);
+            continue;
+          }
+          break;
+        }
+        case KOOPA_RVT_BINARY:
+          resolve(kind.data.binary.lhs);
+          resolve(kind.data.binary.rhs);
+          break;
+        case KOOPA_RVT_BRANCH: {
+          auto &branch = kind.data.branch;
+          assert(!branch.true_args.len && !branch.false_args.len);
+          resolve(branch.cond);
+          int true_id = bb_ids.at(branch.true_bb), false_id = bb_ids.at(branch.false_bb);
+          if (!params[true_id].empty()) {
+            branch.true_bb = split(true_id);
+            edges[b].push_back(branch.true_bb);
+          }
+          if (!params[false_id].empty()) {
+            branch.false_bb = split(false_id);
+            edges[b].push_back(branch.false_bb);
+          }
+          break;
+        }
+        case KOOPA_RVT_JUMP:
+          resolve_all(kind.data.jump.args);
+          kind.data.jump.args = args(bb_ids.at(kind.data.jump.target));
+          break;
+        case KOOPA_RVT_CALL:
+          resolve_all(kind.data.call.args);
+          break;
+        case KOOPA_RVT_RETURN:
+          if (kind.data.ret.value)
+            resolve(kind.data.ret.value);
+          break;
+        default:
+          break;
+      }
+      insts.push_back(inst);
+    }
+    bbs[b]->insts = builder.NewSlice(insts, KOOPA_RSIK_VALUE);
+
+    for (auto it = children[b].rbegin(); it != children[b].rend(); ++it)
+      walk.push_back({*it, -1});
+  }
+
+  vector<const void*> layout;
+  for (size_t b = 0; b < n; ++b) {
+    if (rpo_index[b] < 0)
+      continue;
+    layout.push_back(bbs[b]);
+    layout.insert(layout.end(), edges[b].begin(), edges[b].end());
+  }
+  func->bbs = builder.NewSlice(move(layout), KOOPA_RSIK_BASIC_BLOCK);
+}
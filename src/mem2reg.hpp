@@ -0,0 +1,60 @@
+#ifndef MEM2REG_H
+#define MEM2REG_H
+
+#include <builder.hpp>
+#include <koopa.h>
+
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// promote the allocs of a raw program to SSA values, before the backend
+// (-riscv / -obj mode): every local variable is an alloc that is only
+// loaded and stored, an alloc used any other way stays (Cytron et al.)
+// - blocks in reverse postorder, immediate dominators by the iterative
+//   algorithm of Cooper, Harvey and Kennedy, then dominance frontiers
+// - an alloc gets a block param at the iterated frontier of its stores,
+//   only if some block loads it before storing it (semi-pruned)
+// - a walk down the dominator tree replaces every load by the value on top
+//   of the alloc's stack, drops the stores and the allocs, and has every
+//   jump pass the top values as args; a load before any store reads 0
+// a branch never passes args: an edge from a branch to a block with params
+// gets a block of its own (%edge_<n>, after the branch) that jumps there,
+// blocks no code reaches are dropped
+class Mem2Reg {
+ private:
+  typedef koopa_raw_value_data_t value_t;
+  typedef koopa_raw_basic_block_data_t bb_t;
+  typedef koopa_raw_function_data_t func_t;
+
+  RawIRBuilder &builder;
+
+  // blocks of the function being promoted, by index in func->bbs
+  vector<bb_t*> bbs;
+  unordered_map<koopa_raw_basic_block_t, int> bb_ids;
+  vector<vector<int>> succs;
+  vector<vector<int>> preds;
+  vector<int> rpo;        // reachable blocks in reverse postorder
+  vector<int> rpo_index;  // -1: unreachable
+  vector<int> idom;
+  vector<vector<int>> frontier;
+
+  // promoted allocs, numbered among all the allocs
+  unordered_map<koopa_raw_value_t, int> alloc_ids;
+  size_t alloc_num = 0;
+  size_t load_num = 0;  // loads of them, at most
+  vector<vector<int>> params;  // alloc of every param of a block
+
+  void Graph(func_t *func);
+  void Dominators();
+  void Place();
+  void Rename(func_t *func);
+
+ public:
+  explicit Mem2Reg(RawIRBuilder &builder) : builder(builder) {}
+
+  void Run(const koopa_raw_program_t &program);
+};
+
+#endif
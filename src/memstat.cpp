@@ -0,0 +1,177 @@
+#include <memstat.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+bool mem_accounting = false;
+
+static const char *subsys_name[MEM_SUBSYS_NUM] = {
+    "other", "parse", "ast", "lower", "ir", "backend", "output", "cache",
+};
+
+// plain arrays of atomics: they must work before main and without new
+static atomic<size_t> alloc_cnt[MEM_SUBSYS_NUM];
+static atomic<size_t> alloc_bytes[MEM_SUBSYS_NUM];
+static thread_local mem_subsys_t cur_subsys = MEM_OTHER;
+
+MemScope::MemScope(mem_subsys_t subsys) : saved(cur_subsys) {
+  cur_subsys = subsys;
+}
+
+MemScope::~MemScope() {
+  cur_subsys = saved;
+}
+
+void MemCount(mem_subsys_t subsys, size_t bytes) {
+  if (!mem_accounting)
+    return;
+  alloc_cnt[subsys].fetch_add(1, memory_order_relaxed);
+  alloc_bytes[subsys].fetch_add(bytes, memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+  MemCount(cur_subsys, size);
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    throw bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+// ==================== resident set ==================== //
+
+namespace {
+struct sample_t {
+  const char *phase;
+  size_t count;
+  size_t rss_max;  // KB, largest resident set seen at the end of the phase
+};
+}  // namespace
+
+static const size_t MAX_PHASES = 16;
+static mutex sample_lock;
+static sample_t samples[MAX_PHASES];
+static size_t sample_num = 0;
+
+static size_t CurrentRss() {
+  // second field of statm: resident pages
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  size_t size = 0, resident = 0;
+  if (fscanf(f, "%zu %zu", &size, &resident) != 2)
+    resident = 0;
+  fclose(f);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static size_t PeakRss() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;  // KB on linux
+}
+
+/**
+ * @brief sample the resident set at the end of phase
+ */
+void MemSample(const char *phase) {
+  if (!mem_accounting)
+    return;
+  size_t rss = CurrentRss();
+  lock_guard<mutex> guard(sample_lock);
+  sample_t *sample = nullptr;
+  for (size_t i = 0; i < sample_num; ++i)
+    if (!strcmp(samples[i].phase, phase))
+      sample = &samples[i];
+  if (!sample) {
+    if (sample_num == MAX_PHASES)
+      return;
+    sample = &samples[sample_num++];
+    *sample = {phase, 0, 0};
+  }
+  sample->count++;
+  if (rss > sample->rss_max)
+    sample->rss_max = rss;
+}
+
+// ==================== AST arenas ==================== //
+
+namespace {
+struct arena_t {
+  string name;
+  size_t nodes;
+  size_t bytes;
+  size_t chunks;
+};
+}  // namespace
+
+static mutex arena_lock;
+static vector<arena_t> arenas;  // since the last report
+static atomic<size_t> arena_num;
+static atomic<size_t> arena_nodes;
+static atomic<size_t> arena_bytes;
+static atomic<size_t> arena_chunks;
+static atomic<size_t> arena_bytes_max;  // largest single arena
+
+void MemArena(const char *name, size_t nodes, size_t bytes, size_t chunks) {
+  if (!mem_accounting)
+    return;
+  {
+    lock_guard<mutex> guard(arena_lock);
+    arenas.push_back({name, nodes, bytes, chunks});
+  }
+  arena_num.fetch_add(1, memory_order_relaxed);
+  arena_nodes.fetch_add(nodes, memory_order_relaxed);
+  arena_bytes.fetch_add(bytes, memory_order_relaxed);
+  arena_chunks.fetch_add(chunks, memory_order_relaxed);
+  size_t max = arena_bytes_max.load(memory_order_relaxed);
+  while (bytes > max && !arena_bytes_max.compare_exchange_weak(max, bytes, memory_order_relaxed))
+    ;
+}
+
+void MemReport(FILE *out) {
+  fprintf(out, "%-12s %10s %14s\n", "subsystem", "allocs", "bytes");
+  for (int i = 0; i < MEM_SUBSYS_NUM; ++i)
+    fprintf(out, "%-12s %10zu %14zu\n", subsys_name[i], alloc_cnt[i].load(), alloc_bytes[i].load());
+
+  lock_guard<mutex> guard(sample_lock);
+  fprintf(out, "%-12s %10s %14s\n", "phase", "samples", "rss max(KB)");
+  // the kernel updates the high water mark lazily, it may lag behind a sample
+  size_t peak = PeakRss();
+  for (size_t i = 0; i < sample_num; ++i) {
+    fprintf(out, "%-12s %10zu %14zu\n", samples[i].phase, samples[i].count, samples[i].rss_max);
+    if (samples[i].rss_max > peak)
+      peak = samples[i].rss_max;
+  }
+  fprintf(out, "%-12s %10s %14zu\n", "peak rss", "", peak);
+
+  if (!arena_num.load())
+    return;
+  {
+    // a server reports after every request, so the list does not grow
+    lock_guard<mutex> arena_guard(arena_lock);
+    fprintf(out, "%-12s %10s %14s %8s\n", "arena", "nodes", "bytes", "chunks");
+    for (auto &arena : arenas)
+      fprintf(out, "%-12s %10zu %14zu %8zu\n", arena.name.c_str(), arena.nodes, arena.bytes, arena.chunks);
+    arenas.clear();
+  }
+  fprintf(out, "arena: %zu nodes, %zu bytes in %zu chunks (%zu arenas, largest %zu bytes)\n",
+          arena_nodes.load(), arena_bytes.load(), arena_chunks.load(), arena_num.load(),
+          arena_bytes_max.load());
+}
@@ -0,0 +1,48 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+#include <cstddef>
+#include <cstdio>
+
+// memory accounting for -mem-report
+// every operator new is counted for the subsystem the allocating thread is
+// in (see MemScope), buffers taken from malloc directly are counted by
+// their owners with MemCount, the resident set is sampled at the phase
+// boundaries of every compilation with MemSample and the AST arena of
+// every compilation is counted by MemArena
+// MemReport prints the arenas since the last report, one per compilation,
+// and the totals of all of them
+
+typedef enum {
+  MEM_OTHER,    // outside of any compilation phase
+  MEM_PARSE,    // lexer, parser stacks, recorded tokens
+  MEM_AST,      // arena chunks
+  MEM_LOWER,    // AST Dump: symbol tables, reprs
+  MEM_IR,       // IR builders, the raw program in -riscv mode
+  MEM_BACKEND,  // riscv generation: vmap, registers, machine code
+  MEM_OUTPUT,   // emitter buffers (koopa text or assembly)
+  MEM_CACHE,    // function cache keys and outputs
+  MEM_SUBSYS_NUM,
+} mem_subsys_t;
+
+extern bool mem_accounting;  // set before the first compilation, off by default
+
+void MemCount(mem_subsys_t subsys, size_t bytes);
+void MemSample(const char *phase);
+// the AST arena of compilation name, about to be released
+void MemArena(const char *name, size_t nodes, size_t bytes, size_t chunks);
+void MemReport(FILE *out);
+
+// allocations of this thread go to subsys while in scope
+class MemScope {
+ private:
+  mem_subsys_t saved;
+
+ public:
+  explicit MemScope(mem_subsys_t subsys);
+  MemScope(const MemScope&) = delete;
+  MemScope& operator=(const MemScope&) = delete;
+  ~MemScope();
+};
+
+#endif
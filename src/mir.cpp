@@ -0,0 +1,164 @@
+#include <mir.hpp>
+
+#include <cassert>
+
+// register names by reg id
+static const char* reg_names[] = {
+  "t0", "t1", "t2", "t3", "t4", "t5", "t6",
+  "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7",
+  "x0", "sp", "ra",
+};
+
+const char* format_reg(int reg_num) {
+  assert(reg_num >= 0 && reg_num <= REG_RA);
+  return reg_names[reg_num];
+}
+
+static const char* op_names[] = {
+  "add", "sub", "mul", "div", "rem", "slt", "sgt", "and", "or", "xor",
+  "addi", "xori", "seqz", "snez", "mv", "li", "lw", "sw", "bnez", "beqz", "j", "call", "ret",
+};
+
+void MirFunc::Reset(const char *func_name) {
+  name = func_name;
+  // keep the instruction buffers of the blocks
+  for (auto &block : blocks)
+    block.insts.clear();
+  blocks.resize(1);
+  blocks[0].label = nullptr;
+  cur = 0;
+  syms.clear();
+  slot_size = 0;
+  arg_out_size = 0;
+  has_call = false;
+  frame_size = 0;
+}
+
+int MirFunc::AddBlock(const char *label) {
+  blocks.emplace_back();
+  blocks.back().label = label;
+  return blocks.size() - 1;
+}
+
+void MirFunc::Call(const char *callee) {
+  has_call = true;
+  syms.push_back(callee);
+  OpImm(MIR_CALL, -1, -1, syms.size() - 1);
+}
+
+static bool IsImm12(int32_t imm) {
+  return imm >= -2048 && imm <= 2047;
+}
+
+// sp += delta, through t5 when delta is too big for addi
+static void AdjustSp(vector<mir_inst_t> &out, int32_t delta) {
+  if (!delta)
+    return;
+  if (IsImm12(delta)) {
+    out.push_back({MIR_ADDI, REG_SP, REG_SP, -1, MEM_SP, delta});
+  } else {
+    out.push_back({MIR_LI, REG_T5, -1, -1, MEM_SP, delta});
+    out.push_back({MIR_ADD, REG_SP, REG_SP, REG_T5});
+  }
+}
+
+// push a lw / sw whose offset is from sp, the address goes through a
+// register when the offset is too big: the target of a load, a scratch
+// register not being stored for a store
+static void PushMem(vector<mir_inst_t> &out, mir_inst_t inst) {
+  if (!IsImm12(inst.imm)) {
+    int8_t tmp = inst.op == MIR_LW ? inst.rd : inst.rs2 == REG_T5 ? REG_T6 : REG_T5;
+    out.push_back({MIR_LI, tmp, -1, -1, MEM_SP, inst.imm});
+    out.push_back({MIR_ADD, tmp, inst.rs1, tmp});
+    inst.rs1 = tmp;
+    inst.imm = 0;
+  }
+  out.push_back(inst);
+}
+
+/**
+ * @brief lay out the frame: save ra and move sp in the prologue, restore
+ * them before every ret, and turn every stack offset into one from sp
+ */
+void MirFunc::Finalize() {
+  int size = arg_out_size + slot_size + (has_call ? 4 : 0);
+  frame_size = (size + 15) / 16 * 16;  // align to 16
+  int ra_addr = frame_size - 4;        // multi calls share the same ra slot
+
+  vector<mir_inst_t> out;
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    out.clear();
+    if (b == 0) {
+      AdjustSp(out, -frame_size);
+      if (has_call)
+        PushMem(out, {MIR_SW, -1, REG_SP, REG_RA, MEM_SP, ra_addr});
+    }
+    for (auto inst : blocks[b].insts) {
+      if (inst.op == MIR_RET) {
+        if (has_call)
+          PushMem(out, {MIR_LW, REG_RA, REG_SP, -1, MEM_SP, ra_addr});
+        AdjustSp(out, frame_size);
+      } else if (inst.op == MIR_LW || inst.op == MIR_SW) {
+        if (inst.base == MEM_SLOT)
+          inst.imm += arg_out_size;
+        else if (inst.base == MEM_ARG_IN)
+          inst.imm += frame_size;
+        inst.base = MEM_SP;
+        PushMem(out, inst);
+        continue;
+      }
+      out.push_back(inst);
+    }
+    blocks[b].insts.swap(out);
+  }
+}
+
+void MirFunc::Print(Emitter &out) const {
+  out << "  .text" << '\n';
+  out << "  .globl " << name << '\n';
+  out << name << ":" << '\n';
+  for (auto &block : blocks) {
+    // koopa labels are local to their function, asm labels are not: <func>.<label>
+    if (block.label)
+      out << name << '.' << block.label << ":\n";
+    for (auto &inst : block.insts) {
+      out << "  " << op_names[inst.op];
+      switch (inst.op) {
+        case MIR_ADDI:
+        case MIR_XORI:
+          out << ' ' << format_reg(inst.rd) << ", " << format_reg(inst.rs1) << ", " << inst.imm;
+          break;
+        case MIR_SEQZ:
+        case MIR_SNEZ:
+        case MIR_MV:
+          out << ' ' << format_reg(inst.rd) << ", " << format_reg(inst.rs1);
+          break;
+        case MIR_LI:
+          out << ' ' << format_reg(inst.rd) << ", " << inst.imm;
+          break;
+        case MIR_LW:
+          out << ' ' << format_reg(inst.rd) << ", " << inst.imm << '(' << format_reg(inst.rs1) << ')';
+          break;
+        case MIR_SW:
+          out << ' ' << format_reg(inst.rs2) << ", " << inst.imm << '(' << format_reg(inst.rs1) << ')';
+          break;
+        case MIR_BNEZ:
+        case MIR_BEQZ:
+          out << ' ' << format_reg(inst.rs1) << ", " << name << '.' << blocks[inst.imm].label;
+          break;
+        case MIR_J:
+          out << ' ' << name << '.' << blocks[inst.imm].label;
+          break;
+        case MIR_CALL:
+          out << ' ' << syms[inst.imm];
+          break;
+        case MIR_RET:
+          break;
+        default:
+          out << ' ' << format_reg(inst.rd) << ", " << format_reg(inst.rs1) << ", " << format_reg(inst.rs2);
+          break;
+      }
+      out << '\n';
+    }
+  }
+}
@@ -0,0 +1,119 @@
+#ifndef MIR_H
+#define MIR_H
+
+#include <emitter.hpp>
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// registers: t0 ~ t6, a0 ~ a7, then the ones never allocated
+#define REGNUM 15  // allocatable and scratch registers, the ids below it
+#define REG_T5 5   // t5 and t6: scratch, never allocated
+#define REG_T6 6
+#define REG_A0 7
+#define REG_X0 15
+#define REG_SP 16
+#define REG_RA 17
+
+const char* format_reg(int reg_num);
+
+// machine instructions of RV32IM, with the usual pseudo instructions
+// (li, mv, seqz, snez, sgt, bnez, beqz, j, call, ret)
+typedef enum : uint8_t {
+  MIR_ADD,   // rd, rs1, rs2
+  MIR_SUB,
+  MIR_MUL,
+  MIR_DIV,
+  MIR_REM,
+  MIR_SLT,
+  MIR_SGT,
+  MIR_AND,
+  MIR_OR,
+  MIR_XOR,
+  MIR_ADDI,  // rd, rs1, imm
+  MIR_XORI,
+  MIR_SEQZ,  // rd, rs1
+  MIR_SNEZ,
+  MIR_MV,
+  MIR_LI,    // rd, imm
+  MIR_LW,    // rd, imm(rs1)
+  MIR_SW,    // rs2, imm(rs1)
+  MIR_BNEZ,  // rs1, imm: target block
+  MIR_BEQZ,
+  MIR_J,     // imm: target block
+  MIR_CALL,  // imm: callee in syms
+  MIR_RET,   // the epilogue is added by Finalize
+} mir_op_t;
+
+// what the offset of a lw / sw is relative to, the frame is laid out by
+// Finalize: from sp up, args passed on stack, slots, ra
+typedef enum : uint8_t {
+  MEM_SP,       // rs1 itself
+  MEM_SLOT,     // allocs and spilled values
+  MEM_ARG_OUT,  // args of a call past the eighth
+  MEM_ARG_IN,   // params past the eighth, in the frame of the caller
+} mir_base_t;
+
+struct mir_inst_t {
+  mir_op_t op;
+  int8_t rd = -1;
+  int8_t rs1 = -1;
+  int8_t rs2 = -1;
+  mir_base_t base = MEM_SP;
+  int32_t imm = 0;
+};
+
+struct mir_block_t {
+  const char *label;  // null for the prologue block
+  vector<mir_inst_t> insts;
+};
+
+// a function in machine instructions
+// instruction selection appends to the current block, Finalize sizes the
+// frame and resolves the stack offsets, Print writes assembly
+class MirFunc {
+ private:
+  int cur = 0;  // block being appended to
+
+ public:
+  const char *name = nullptr;
+  vector<mir_block_t> blocks;  // blocks[0] is the prologue, falls through
+  vector<const char*> syms;    // callees
+  int slot_size = 0;           // bytes of slots
+  int arg_out_size = 0;        // bytes of args passed on stack, max over calls
+  bool has_call = false;       // ra is saved
+  int frame_size = 0;          // set by Finalize
+
+  // start a function with the prologue block, the blocks are kept for reuse
+  void Reset(const char *func_name);
+  int AddBlock(const char *label);
+  int NewSlot() { slot_size += 4; return slot_size - 4; }  // offset of a new 4 byte slot
+  void SetBlock(int block) { cur = block; }
+
+  void Emit(const mir_inst_t &inst) { blocks[cur].insts.push_back(inst); }
+  void Op(mir_op_t op, int rd, int rs1, int rs2 = -1) {
+    Emit({op, (int8_t)rd, (int8_t)rs1, (int8_t)rs2});
+  }
+  void OpImm(mir_op_t op, int rd, int rs1, int32_t imm) {
+    Emit({op, (int8_t)rd, (int8_t)rs1, -1, MEM_SP, imm});
+  }
+  void Li(int rd, int32_t imm) { OpImm(MIR_LI, rd, -1, imm); }
+  void Mv(int rd, int rs) { Op(MIR_MV, rd, rs); }
+  void Lw(int rd, mir_base_t base, int32_t offset) {
+    Emit({MIR_LW, (int8_t)rd, REG_SP, -1, base, offset});
+  }
+  void Sw(int rs, mir_base_t base, int32_t offset) {
+    Emit({MIR_SW, -1, REG_SP, (int8_t)rs, base, offset});
+  }
+  void Bnez(int rs, int block) { OpImm(MIR_BNEZ, -1, rs, block); }
+  void J(int block) { OpImm(MIR_J, -1, -1, block); }
+  void Call(const char *callee);
+  void Ret() { Emit({MIR_RET}); }
+
+  void Finalize();
+  void Print(Emitter &out) const;
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include <peephole.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <utility>
+
+static const char* rule_names[] = {
+  "forward", "dead-store", "li", "mv", "branch", "cmp",
+};
+
+bool Peephole::ParseRules(const char *list, uint32_t &rules) {
+  rules = 0;
+  if (!strcmp(list, "none"))
+    return true;
+  if (!strcmp(list, "all")) {
+    rules = ALL;
+    return true;
+  }
+  string names(list);
+  size_t begin = 0;
+  while (begin <= names.size()) {
+    size_t end = names.find(',', begin);
+    if (end == string::npos)
+      end = names.size();
+    string name = names.substr(begin, end - begin);
+    int rule = 0;
+    while (rule < PEEP_NUM && name != rule_names[rule])
+      ++rule;
+    if (rule == PEEP_NUM)
+      return false;
+    rules |= 1u << rule;
+    begin = end + 1;
+  }
+  return true;
+}
+
+// register written by an instruction, -1 for none
+static int DefReg(const mir_inst_t &inst) {
+  switch (inst.op) {
+    case MIR_SW:
+    case MIR_BNEZ:
+    case MIR_BEQZ:
+    case MIR_J:
+    case MIR_CALL:
+    case MIR_RET:
+      return -1;
+    default:
+      return inst.rd;
+  }
+}
+
+// li that is a single addi or lui
+static bool IsShortLi(int32_t imm) {
+  return (imm >= -2048 && imm <= 2047) || !(imm & 0xfff);
+}
+
+void Peephole::Run(MirFunc &func) {
+  size_t applied[PEEP_NUM] = {};
+  vector<mir_inst_t> out;
+  for (auto &block : func.blocks)
+    Local(block.insts, out, applied);
+  if (On(PEEP_DEAD_STORE))
+    DeadStores(func, out, applied);
+  if (On(PEEP_BRANCH))
+    Branches(func, applied);
+  for (int rule = 0; rule < PEEP_NUM; ++rule) {
+    if (applied[rule])
+      counts[rule] += applied[rule];
+  }
+}
+
+/**
+ * @brief forward, li, mv and cmp over a block: follow the constants in
+ * registers and the registers holding slots from the start of the block
+ */
+void Peephole::Local(vector<mir_inst_t> &insts, vector<mir_inst_t> &out, size_t *applied) const {
+  bool known[REG_RA + 1] = {};
+  int32_t value[REG_RA + 1] = {};
+  known[REG_X0] = true;
+  vector<pair<int32_t, int>> holds;  // (slot, register with its value)
+
+  auto forget = [&](bool by_slot, int32_t key) {
+    for (size_t i = 0; i < holds.size();) {
+      if ((by_slot ? holds[i].first : holds[i].second) == key) {
+        holds[i] = holds.back();
+        holds.pop_back();
+      } else {
+        ++i;
+      }
+    }
+  };
+  auto clobber = [&](int reg) {
+    if (reg == REG_X0)
+      return;
+    known[reg] = false;
+    forget(false, reg);
+  };
+  auto holder = [&](int32_t slot) {
+    for (auto &hold : holds) {
+      if (hold.first == slot)
+        return hold.second;
+    }
+    return -1;
+  };
+
+  out.clear();
+  for (size_t i = 0; i < insts.size(); ++i) {
+    mir_inst_t inst = insts[i];
+    bool slot_load = inst.op == MIR_LW && inst.base == MEM_SLOT;
+    int32_t slot = inst.imm;
+
+    switch (inst.op) {
+      case MIR_LW:
+        if (slot_load && On(PEEP_FORWARD)) {
+          int reg = holder(slot);
+          if (reg >= 0) {
+            applied[PEEP_FORWARD]++;
+            if (reg == inst.rd)
+              continue;
+            inst = {MIR_MV, inst.rd, (int8_t)reg};
+          }
+        }
+        break;
+      case MIR_LI:
+        if (On(PEEP_LI)) {
+          if (known[inst.rd] && value[inst.rd] == inst.imm) {
+            applied[PEEP_LI]++;
+            continue;
+          }
+          // a copy is only shorter than lui + addi
+          for (int reg = 0; reg <= REG_RA && !IsShortLi(inst.imm); ++reg) {
+            if (known[reg] && value[reg] == inst.imm) {
+              applied[PEEP_LI]++;
+              inst = {MIR_MV, inst.rd, (int8_t)reg};
+              break;
+            }
+          }
+        }
+        break;
+      case MIR_MV:
+        if (On(PEEP_MV) && inst.rd == inst.rs1) {
+          applied[PEEP_MV]++;
+          continue;
+        }
+        break;
+      case MIR_XOR:
+        if (On(PEEP_CMP) && (inst.rs1 == REG_X0 || inst.rs2 == REG_X0) && i + 1 < insts.size()) {
+          const mir_inst_t &next = insts[i + 1];
+          if ((next.op == MIR_SEQZ || next.op == MIR_SNEZ) && next.rd == inst.rd && next.rs1 == inst.rd) {
+            applied[PEEP_CMP]++;
+            inst = {next.op, inst.rd, inst.rs1 == REG_X0 ? inst.rs2 : inst.rs1};
+            ++i;
+          }
+        }
+        break;
+      default:
+        break;
+    }
+
+    // what the instruction leaves in registers and slots
+    if (inst.op == MIR_CALL) {
+      for (int reg = 0; reg <= REG_RA; ++reg)
+        known[reg] = reg == REG_X0;
+      holds.clear();
+    } else if (inst.op == MIR_SW) {
+      // Finalize may compute a big offset in a scratch register
+      clobber(inst.rs2 == REG_T5 ? REG_T6 : REG_T5);
+      if (inst.base == MEM_SLOT) {
+        forget(true, inst.imm);
+        holds.push_back({inst.imm, inst.rs2});
+      }
+    } else {
+      int rd = DefReg(inst);
+      if (rd >= 0) {
+        bool rd_known = inst.op == MIR_LI || (inst.op == MIR_MV && known[inst.rs1]);
+        int32_t rd_value = inst.op == MIR_LI ? inst.imm : inst.op == MIR_MV ? value[inst.rs1] : 0;
+        clobber(rd);
+        known[rd] = rd_known;
+        value[rd] = rd_value;
+        if (slot_load)
+          holds.push_back({slot, rd});
+      }
+    }
+    out.push_back(inst);
+  }
+  insts.swap(out);
+}
+
+/**
+ * @brief drop the stores to slots no instruction loads, and the ones
+ * stored again later in the block with no load in between
+ */
+void Peephole::DeadStores(MirFunc &func, vector<mir_inst_t> &out, size_t *applied) const {
+  int slot_num = func.slot_size / 4;
+  vector<bool> loaded(slot_num, false);
+  for (auto &block : func.blocks) {
+    for (auto &inst : block.insts) {
+      if (inst.op == MIR_LW && inst.base == MEM_SLOT)
+        loaded[inst.imm / 4] = true;
+    }
+  }
+
+  vector<int> stored(slot_num, -1);  // block whose later part stores the slot first
+  for (size_t b = 0; b < func.blocks.size(); ++b) {
+    auto &insts = func.blocks[b].insts;
+    out.clear();
+    for (size_t i = insts.size(); i-- > 0;) {
+      const mir_inst_t &inst = insts[i];
+      if (inst.base == MEM_SLOT && inst.op == MIR_LW) {
+        stored[inst.imm / 4] = -1;
+      } else if (inst.base == MEM_SLOT && inst.op == MIR_SW) {
+        int s = inst.imm / 4;
+        if (!loaded[s] || stored[s] == (int)b) {
+          applied[PEEP_DEAD_STORE]++;
+          continue;
+        }
+        stored[s] = b;
+      }
+      out.push_back(inst);
+    }
+    if (out.size() != insts.size())
+      insts.assign(out.rbegin(), out.rend());
+  }
+}
+
+// at most the bytes an instruction takes once finalized and encoded: li
+// + add for a big stack offset, the epilogue of ret
+static int MaxBytes(const mir_inst_t &inst) {
+  return inst.op == MIR_RET ? 32 : 16;
+}
+
+/**
+ * @brief let blocks fall through: drop a j to the next block, and turn
+ * a bnez over it into a beqz to where the j went, if that surely stays in
+ * reach of a branch (+-4KiB, the j reaches 1MiB)
+ */
+void Peephole::Branches(MirFunc &func, size_t *applied) const {
+  vector<int> block_end(func.blocks.size() + 1, 0);  // upper bounds, from the start
+  for (size_t b = 0; b < func.blocks.size(); ++b) {
+    block_end[b + 1] = block_end[b];
+    for (auto &inst : func.blocks[b].insts)
+      block_end[b + 1] += MaxBytes(inst);
+  }
+
+  for (size_t b = 0; b + 1 < func.blocks.size(); ++b) {
+    auto &insts = func.blocks[b].insts;
+    int next = b + 1;
+    if (insts.empty() || insts.back().op != MIR_J)
+      continue;
+    size_t n = insts.size();
+    int target = insts.back().imm;
+    if (target == next) {
+      insts.pop_back();
+      applied[PEEP_BRANCH]++;
+      // both ways lead to the next block
+      if (n >= 2 && insts.back().op == MIR_BNEZ && insts.back().imm == next) {
+        insts.pop_back();
+        applied[PEEP_BRANCH]++;
+      }
+    } else if (n >= 2 && insts[n - 2].op == MIR_BNEZ && insts[n - 2].imm == next &&
+               max(block_end[b + 1] - block_end[target], block_end[target] - block_end[b]) < 4096) {
+      insts[n - 2].op = MIR_BEQZ;
+      insts[n - 2].imm = target;
+      insts.pop_back();
+      applied[PEEP_BRANCH]++;
+    }
+  }
+}
+
+void Peephole::Report(FILE *out) const {
+  fprintf(out, "peephole:");
+  for (int rule = 0; rule < PEEP_NUM; ++rule)
+    fprintf(out, " %s %zu%s", rule_names[rule], counts[rule].load(), rule + 1 < PEEP_NUM ? "," : "\n");
+}
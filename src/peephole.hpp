@@ -0,0 +1,57 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <mir.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+// rewrites of the peephole pass, rule i is bit i of the enabled set
+typedef enum : uint8_t {
+  PEEP_FORWARD,     // lw of a slot whose value a register holds: mv, or nothing
+  PEEP_DEAD_STORE,  // sw to a slot never loaded, or stored again before a load
+  PEEP_LI,          // li of a value a register holds
+  PEEP_MV,          // mv to the same register
+  PEEP_BRANCH,      // j to the next block, bnez over it
+  PEEP_CMP,         // xor with x0 then seqz / snez: test the other operand
+  PEEP_NUM,
+} peep_rule_t;
+
+// peephole pass over the machine code of a function, run between
+// instruction selection and Finalize (stack offsets are still by slot, no
+// epilogue yet), one instance shared by every thread of the process
+// - what registers and slots hold is followed within a block, all of it
+//   is forgotten at a label and registers at a call (all caller saved)
+// - slots are never addressed but by lw / sw, and only this function
+//   reaches them
+// the rewrites are counted per rule over all functions (-peephole-report)
+class Peephole {
+ private:
+  uint32_t rules;
+  atomic<size_t> counts[PEEP_NUM] = {};
+
+  bool On(peep_rule_t rule) const { return rules >> rule & 1; }
+  void Local(vector<mir_inst_t> &insts, vector<mir_inst_t> &out, size_t *applied) const;
+  void DeadStores(MirFunc &func, vector<mir_inst_t> &out, size_t *applied) const;
+  void Branches(MirFunc &func, size_t *applied) const;
+
+ public:
+  static const uint32_t ALL = (1u << PEEP_NUM) - 1;
+
+  explicit Peephole(uint32_t rules = ALL) : rules(rules) {}
+  Peephole(const Peephole&) = delete;
+  Peephole& operator=(const Peephole&) = delete;
+
+  // "all", "none" or rule names separated by commas, false on an unknown name
+  static bool ParseRules(const char *list, uint32_t &rules);
+  uint32_t Rules() const { return rules; }  // part of the cache key
+
+  void Run(MirFunc &func);
+  void Report(FILE *out) const;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include <pool.hpp>
+
+static thread_local const ThreadPool *cur_pool = nullptr;
+static thread_local int worker_id = -1;
+
+ThreadPool::ThreadPool(int thread_num) {
+  if (thread_num <= 0)
+    thread_num = thread::hardware_concurrency();
+  if (thread_num <= 0)
+    thread_num = 1;
+
+  for (int i = 0; i < thread_num; ++i)
+    queues.push_back(make_unique<queue_t>());
+  for (int i = 0; i < thread_num - 1; ++i)
+    workers.emplace_back(&ThreadPool::Work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> guard(idle_lock);
+    stop = true;
+  }
+  idle.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+int ThreadPool::Self() const {
+  if (cur_pool == this)
+    return worker_id;
+  return queues.size() - 1;
+}
+
+/**
+ * @brief take a task, own queue first (newest), then steal (oldest)
+ *
+ * @param self queue of the calling thread
+ * @param task where the task is moved to
+ * @return bool whether a task is found
+ */
+bool ThreadPool::Pop(int self, task_t &task) {
+  int queue_num = queues.size();
+  for (int i = 0; i < queue_num; ++i) {
+    queue_t &queue = *queues[(self + i) % queue_num];
+    lock_guard<mutex> guard(queue.lock);
+    if (queue.tasks.empty())
+      continue;
+    if (i == 0) {
+      task = move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    queued--;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::Work(int id) {
+  cur_pool = this;
+  worker_id = id;
+  for (;;) {
+    task_t task;
+    if (Pop(id, task)) {
+      task.fn();
+      task.remaining->fetch_sub(1);
+      continue;
+    }
+    unique_lock<mutex> guard(idle_lock);
+    idle.wait(guard, [this] { return stop || queued > 0; });
+    if (stop && queued == 0)
+      return;
+  }
+}
+
+void ThreadPool::Run(vector<function<void()>> &tasks) {
+  if (tasks.empty())
+    return;
+
+  // a worker keeps its batch local (others steal it), an outside caller
+  // deals the batch out to every queue
+  atomic<size_t> remaining{tasks.size()};
+  int self = Self();
+  int queue_num = queues.size();
+  queued += tasks.size();
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    int target = cur_pool == this ? self : i % queue_num;
+    lock_guard<mutex> guard(queues[target]->lock);
+    queues[target]->tasks.push_back({move(tasks[i]), &remaining});
+  }
+  {
+    // a worker between its predicate check and wait() would miss the notify
+    lock_guard<mutex> guard(idle_lock);
+  }
+  idle.notify_all();
+
+  // help until the whole batch is done
+  while (remaining > 0) {
+    task_t task;
+    if (Pop(self, task)) {
+      task.fn();
+      task.remaining->fetch_sub(1);
+    } else {
+      this_thread::yield();
+    }
+  }
+  tasks.clear();
+}
@@ -0,0 +1,56 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// work-stealing thread pool
+// every worker owns a deque: it pops its own work from the back and
+// steals from the front of the others when it runs dry.
+// Run() may be called from inside a task, the caller keeps running tasks
+// until its batch is done, so nested batches never deadlock.
+class ThreadPool {
+ private:
+  struct task_t {
+    function<void()> fn;
+    atomic<size_t> *remaining;  // unfinished tasks of its batch
+  };
+
+  struct queue_t {
+    mutex lock;
+    deque<task_t> tasks;
+  };
+
+  vector<unique_ptr<queue_t>> queues;  // one per worker, the last one for outside threads
+  vector<thread> workers;
+  atomic<size_t> queued{0};  // tasks sitting in the queues
+  atomic<bool> stop{false};
+  mutex idle_lock;
+  condition_variable idle;
+
+  int Self() const;  // queue of the calling thread
+  bool Pop(int self, task_t &task);
+  void Work(int id);
+
+ public:
+  // thread_num threads work on a batch, the one calling Run() included
+  // 0 means one per core
+  explicit ThreadPool(int thread_num);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  // run all tasks and return when they are finished
+  void Run(vector<function<void()>> &tasks);
+  int size() const { return workers.size() + 1; }
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include <regalloc.hpp>
+
+#include <context.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// allocation order: t registers first, then a registers from a7 down,
+// a0 and a1 are the most likely to be wanted by a call
+static const int alloc_order[] = {
+  0, 1, 2, 3, 4,
+  REG_A0 + 7, REG_A0 + 6, REG_A0 + 5, REG_A0 + 4, REG_A0 + 3, REG_A0 + 2, REG_A0 + 1, REG_A0,
+};
+
+void RegAlloc::Run(const koopa_raw_function_t &func) {
+  Number(func);
+  Liveness();
+  Scan();
+}
+
+/**
+ * @brief collect the blocks, the loop depths and the uses of every value
+ */
+void RegAlloc::Number(const koopa_raw_function_t &func) {
+  int n = ctx->vmap.size();
+  int param_num = func->params.len;
+  blocks.clear();
+  block_ids.clear();
+  call_pos.clear();
+  def_block.assign(n, 0);
+  start.resize(n);
+  for (int i = 0; i < n; ++i)
+    start[i] = i;
+  end.assign(n, -1);
+  weight.assign(n, 0);
+  hint.assign(n, -1);
+  partner.assign(n, -1);
+  spill.assign(n, false);
+
+  int pos = param_num;
+  for (size_t i = 0; i < func->bbs.len; ++i) {
+    auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+    block_ids[bb] = i;
+    int len = bb->params.len + bb->insts.len;
+    blocks.push_back({pos, pos + len - 1, 0, {}});
+    pos += len;
+  }
+
+  // edges, a jump back to an earlier block closes a loop over the blocks
+  // in between (the front end lays loops out in order)
+  vector<int> depth_diff(blocks.size() + 1, 0);
+  for (size_t i = 0; i < func->bbs.len; ++i) {
+    auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+    if (!bb->insts.len)
+      continue;
+    auto last = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[bb->insts.len - 1]);
+    koopa_raw_basic_block_t succs[2] = {nullptr, nullptr};
+    if (last->kind.tag == KOOPA_RVT_BRANCH) {
+      succs[0] = last->kind.data.branch.true_bb;
+      succs[1] = last->kind.data.branch.false_bb;
+    } else if (last->kind.tag == KOOPA_RVT_JUMP) {
+      succs[0] = last->kind.data.jump.target;
+    }
+    for (auto succ : succs) {
+      if (!succ)
+        continue;
+      int s = block_ids.at(succ);
+      blocks[s].preds.push_back(i);
+      if (s <= (int)i) {
+        depth_diff[s]++;
+        depth_diff[i + 1]--;
+      }
+    }
+  }
+  int depth = 0;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    depth += depth_diff[i];
+    blocks[i].depth = depth;
+  }
+
+  // uses, grouped by value later
+  struct use_t {
+    int id;
+    int pos;
+    int block;
+  };
+  vector<use_t> uses;
+  for (int i = 0; i < param_num && i < 8; ++i)
+    hint[i] = REG_A0 + i;
+
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[b]);
+    float w = pow(10.0f, min(blocks[b].depth, 8));
+    // returns the number of a used value, -1 for integers, globals and allocs
+    auto use = [&](koopa_raw_value_t value, int p) {
+      int id = ctx->vmap.Index(value);
+      if (id < 0 || value->kind.tag == KOOPA_RVT_ALLOC)
+        return -1;
+      uses.push_back({id, p, (int)b});
+      weight[id] += w;
+      return id;
+    };
+
+    // params are defined on entry, by the jumps here
+    for (size_t j = 0; j < bb->params.len; ++j) {
+      int p = blocks[b].start + j;
+      def_block[p] = b;
+      weight[p] += w;
+    }
+    for (size_t j = 0; j < bb->insts.len; ++j) {
+      int p = blocks[b].start + bb->params.len + j;
+      auto inst = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+      def_block[p] = b;
+      weight[p] += w;
+      const auto &kind = inst->kind;
+      switch (kind.tag) {
+        case KOOPA_RVT_STORE:
+          use(kind.data.store.value, p);
+          break;
+        case KOOPA_RVT_BINARY:
+          use(kind.data.binary.lhs, p);
+          use(kind.data.binary.rhs, p);
+          break;
+        case KOOPA_RVT_BRANCH:
+          use(kind.data.branch.cond, p);
+          assert(!kind.data.branch.true_args.len && !kind.data.branch.false_args.len);
+          break;
+        case KOOPA_RVT_JUMP: {
+          // an arg and its param like the same register: no move
+          auto target = kind.data.jump.target;
+          for (size_t k = 0; k < kind.data.jump.args.len; ++k) {
+            int id = use(reinterpret_cast<koopa_raw_value_t>(kind.data.jump.args.buffer[k]), p);
+            int param = ctx->vmap.Index(reinterpret_cast<koopa_raw_value_t>(target->params.buffer[k]));
+            if (id >= 0) {
+              partner[id] = param;
+              partner[param] = id;
+            }
+          }
+          break;
+        }
+        case KOOPA_RVT_RETURN:
+          if (kind.data.ret.value) {
+            int id = use(kind.data.ret.value, p);
+            if (id >= param_num)
+              hint[id] = REG_A0;
+          }
+          break;
+        case KOOPA_RVT_CALL:
+          call_pos.push_back(p);
+          hint[p] = REG_A0;
+          for (size_t k = 0; k < kind.data.call.args.len; ++k) {
+            int id = use(reinterpret_cast<koopa_raw_value_t>(kind.data.call.args.buffer[k]), p);
+            if (id >= param_num && k < 8)  // params keep their own
+              hint[id] = REG_A0 + k;
+          }
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  // counting sort by value
+  use_begin.assign(n + 1, 0);
+  for (auto &use : uses)
+    use_begin[use.id + 1]++;
+  for (int i = 0; i < n; ++i)
+    use_begin[i + 1] += use_begin[i];
+  use_pos.resize(uses.size());
+  use_block.resize(uses.size());
+  vector<int> fill(use_begin.begin(), use_begin.end() - 1);
+  for (auto &use : uses) {
+    use_pos[fill[use.id]] = use.pos;
+    use_block[fill[use.id]++] = use.block;
+  }
+}
+
+/**
+ * @brief stretch every interval over the blocks its value is live in:
+ * from each use up through the predecessors until the def
+ */
+void RegAlloc::Liveness() {
+  int n = start.size();
+  live_in.assign(blocks.size(), -1);
+  vector<int> work;
+  for (int v = 0; v < n; ++v) {
+    for (int u = use_begin[v]; u < use_begin[v + 1]; ++u) {
+      int p = use_pos[u];
+      int b = use_block[u];
+      end[v] = max(end[v], p);
+      if (b == def_block[v] && v < p)
+        continue;  // used in its own block
+      work.push_back(b);
+      while (!work.empty()) {
+        int x = work.back();
+        work.pop_back();
+        if (live_in[x] == v)
+          continue;
+        live_in[x] = v;
+        start[v] = min(start[v], blocks[x].start);
+        for (int q : blocks[x].preds) {
+          // live out of q
+          end[v] = max(end[v], blocks[q].end);
+          if (q != def_block[v])
+            work.push_back(q);
+        }
+      }
+    }
+
+    // live across a call: every register is clobbered there
+    if (end[v] >= 0) {
+      auto call = upper_bound(call_pos.begin(), call_pos.end(), start[v]);
+      if (call != call_pos.end() && *call < end[v])
+        spill[v] = true;
+    }
+  }
+}
+
+void RegAlloc::Spill(int id) {
+  ctx->vmap.Set(id, {false, ctx->mir.NewSlot()});
+}
+
+void RegAlloc::Scan() {
+  int n = start.size();
+  int param_num = blocks.empty() ? n : blocks[0].start;
+  vector<int> order;
+  for (int v = 0; v < n; ++v) {
+    // params past the eighth stay where the caller put them
+    if (end[v] >= 0 && !(v < param_num && v >= 8))
+      order.push_back(v);
+  }
+  sort(order.begin(), order.end(), [&](int a, int b) {
+    return start[a] != start[b] ? start[a] < start[b] : a < b;
+  });
+
+  bool busy[REGNUM] = {};
+  vector<int> active;
+  for (int v : order) {
+    // expire, the def of v may reuse the register of an operand dying there
+    for (size_t i = 0; i < active.size();) {
+      int a = active[i];
+      if (end[a] < start[v] || (end[a] == start[v] && start[v] == v)) {
+        busy[ctx->vmap.Get(a).addr] = false;
+        active[i] = active.back();
+        active.pop_back();
+      } else {
+        ++i;
+      }
+    }
+
+    if (spill[v]) {
+      Spill(v);
+      continue;
+    }
+    int reg = -1;
+    int mate = partner[v];
+    if (hint[v] >= 0 && !busy[hint[v]]) {
+      reg = hint[v];
+    } else if (ctx->vmap.Known(mate) && ctx->vmap.Get(mate).is_reg && !busy[ctx->vmap.Get(mate).addr]) {
+      reg = ctx->vmap.Get(mate).addr;
+    } else {
+      for (int r : alloc_order) {
+        if (!busy[r]) {
+          reg = r;
+          break;
+        }
+      }
+    }
+    if (reg < 0) {
+      // no register free: the cheapest interval goes to the stack
+      int victim = v;
+      size_t victim_at = active.size();
+      for (size_t i = 0; i < active.size(); ++i) {
+        int a = active[i];
+        if (weight[a] < weight[victim] || (weight[a] == weight[victim] && end[a] > end[victim])) {
+          victim = a;
+          victim_at = i;
+        }
+      }
+      if (victim == v) {
+        Spill(v);
+        continue;
+      }
+      reg = ctx->vmap.Get(victim).addr;
+      Spill(victim);
+      active[victim_at] = active.back();
+      active.pop_back();
+    }
+    busy[reg] = true;
+    ctx->vmap.Set(v, {true, reg});
+    active.push_back(v);
+  }
+}
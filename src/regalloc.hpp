@@ -0,0 +1,66 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <ir.hpp>
+#include <koopa.h>
+
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// linear scan register allocation of a function
+// positions are the value numbers of ctx->vmap (params, then block params
+// and instructions in order), every value gets one interval [start, end] from its def to its
+// last use, stretched over the blocks it is live in. Intervals are scanned
+// by start over t0 ~ t4 and a0 ~ a7 (t5 and t6 are the scratch registers of
+// the code generator):
+// - all these registers are caller saved, a value live across a call goes
+//   to the stack
+// - otherwise when no register is free the interval with the lowest spill
+//   weight (its defs and uses, 10 ^ loop depth each) goes to the stack
+// - integers get no interval, they are rematerialized with li at every use
+// - a block param is defined at the start of its block, its args are used
+//   at the jumps there; they prefer the register of each other, to save the
+//   moves of the jump
+// the result is the repr of every value in ctx->vmap: a register or a stack
+// slot, a value never used has none
+class RegAlloc {
+ private:
+  struct block_t {
+    int start;  // position of the first param or instruction / the last instruction
+    int end;
+    int depth;  // loop depth
+    vector<int> preds;
+  };
+
+  vector<block_t> blocks;
+  unordered_map<koopa_raw_basic_block_t, int> block_ids;
+
+  // by value number
+  vector<int> def_block;
+  vector<int> start;
+  vector<int> end;      // -1: never used
+  vector<float> weight;
+  vector<int> hint;     // preferred register, -1 for none
+  vector<int> partner;  // block param of a jump arg or the other way, -1 for none
+  vector<bool> spill;   // must go to the stack
+
+  // uses grouped by value: use_pos[use_begin[v] ~ use_begin[v + 1])
+  vector<int> use_begin;
+  vector<int> use_pos;
+  vector<int> use_block;
+  vector<int> call_pos;
+  vector<int> live_in;  // value whose liveness last reached the block
+
+  void Number(const koopa_raw_function_t &func);
+  void Liveness();
+  void Scan();
+  void Spill(int id);
+
+ public:
+  void Run(const koopa_raw_function_t &func);
+  int BlockId(koopa_raw_basic_block_t bb) const { return block_ids.at(bb); }  // in func->bbs
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include <server.hpp>
+
+#include <trace.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static bool ReadFull(int fd, char *p, size_t n) {
+  while (n > 0) {
+    ssize_t got = read(fd, p, n);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    p += got;
+    n -= got;
+  }
+  return true;
+}
+
+static bool WriteFull(int fd, const char *p, size_t n) {
+  while (n > 0) {
+    // a client that went away must not kill the server with SIGPIPE
+    ssize_t put = send(fd, p, n, MSG_NOSIGNAL);
+    if (put < 0 && errno == EINTR)
+      continue;
+    if (put <= 0)
+      return false;
+    p += put;
+    n -= put;
+  }
+  return true;
+}
+
+static void Reply(int fd, int status, const char *data, size_t len) {
+  char header[32];
+  int n = snprintf(header, sizeof(header), "%d %zu\n", status, len);
+  if (WriteFull(fd, header, n))
+    WriteFull(fd, data, len);
+}
+
+CompileServer::~CompileServer() {
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    unlink(path.c_str());
+  }
+}
+
+/**
+ * @brief bind and listen on a unix domain socket, a stale socket file of
+ * an earlier server is replaced
+ */
+bool CompileServer::Listen(const char *socket_path) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path))
+    return false;
+  strcpy(addr.sun_path, socket_path);
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0)
+    return false;
+  unlink(socket_path);
+  if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(listen_fd, SOMAXCONN) != 0) {
+    close(listen_fd);
+    listen_fd = -1;
+    return false;
+  }
+  path = socket_path;
+  return true;
+}
+
+void CompileServer::Run(int thread_num) {
+  vector<thread> threads;
+  for (int i = 1; i < thread_num; ++i)
+    threads.emplace_back(&CompileServer::Serve, this);
+  Serve();
+  for (auto &t : threads)
+    t.join();
+}
+
+void CompileServer::Serve() {
+  // reused by every request of this thread
+  string source;
+  Emitter out;
+  for (;;) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      TRACE(TRACE_SERVER, TRACE_INFO, "accept: %s", strerror(errno));
+      return;
+    }
+    Handle(fd, source, out);
+    close(fd);
+  }
+}
+
+void CompileServer::Handle(int fd, string &source, Emitter &out) {
+  // the header is a few bytes, read up to its newline only
+  char header[64];
+  size_t n = 0;
+  while (n < sizeof(header) - 1) {
+    if (!ReadFull(fd, header + n, 1))
+      return;
+    if (header[n++] == '\n')
+      break;
+  }
+  header[n] = '\0';
+
+  char mode[16];
+  size_t size;
+  if (header[n - 1] != '\n' || sscanf(header, "%15s %zu", mode, &size) != 2 || size > MAX_SOURCE) {
+    static const char msg[] = "bad request";
+    Reply(fd, 1, msg, sizeof(msg) - 1);
+    return;
+  }
+  source.resize(size);
+  if (!ReadFull(fd, &source[0], size))
+    return;
+
+  TRACE(TRACE_SERVER, TRACE_INFO, "%s: %zu bytes", mode, size);
+  out.Clear();
+  if (compile(mode, source.data(), size, out)) {
+    Reply(fd, 0, out.data(), out.size());
+  } else {
+    static const char msg[] = "compile error";
+    Reply(fd, 1, msg, sizeof(msg) - 1);
+  }
+}
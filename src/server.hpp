@@ -0,0 +1,46 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <emitter.hpp>
+
+#include <functional>
+#include <string>
+
+using namespace std;
+
+// long running compile server on a unix domain socket, so many small
+// compiles pay process startup and library loading only once
+//
+// one request per connection:
+//   request:  "<mode> <size>\n" then <size> bytes of source
+//   response: "<status> <size>\n" then <size> bytes, the output (status 0)
+//             or an error message (status 1)
+//
+// every serving thread accepts connections on its own and keeps its
+// buffers (and arena chunks, see arena.cpp) warm between requests
+class CompileServer {
+ public:
+  // compile src in mode into out, false if it is rejected
+  typedef function<bool(const char *mode, const char *src, size_t len, Emitter &out)> compile_t;
+
+ private:
+  static const size_t MAX_SOURCE = 1 << 30;
+
+  string path;
+  int listen_fd = -1;
+  compile_t compile;
+
+  void Serve();  // accept loop of one thread
+  void Handle(int fd, string &source, Emitter &out);
+
+ public:
+  explicit CompileServer(compile_t compile) : compile(move(compile)) {}
+  CompileServer(const CompileServer&) = delete;
+  CompileServer& operator=(const CompileServer&) = delete;
+  ~CompileServer();
+
+  bool Listen(const char *socket_path);
+  void Run(int thread_num);  // serve forever on thread_num threads
+};
+
+#endif
@@ -2,6 +2,7 @@
   #include <memory>
   #include <string>
   #include <ast.hpp>
+  #include <lexer.hpp>
 }
 
 %{
@@ -12,171 +13,200 @@
 #include <cassert>
 #include <vector>
 #include <ast.hpp>
-
-// 声明 lexer 函数和错误处理函数
-int yylex();
-void yyerror(std::unique_ptr<BaseAST> &ast, const char *s);
+#include <context.hpp>
+#include <trace.hpp>
 
 using namespace std;
 
 %}
 
+// 声明 lexer 函数和错误处理函数
+// 用到了 YYSTYPE, 所以要放在 %code 里 (生成在 YYSTYPE 的定义之后)
+%code {
+int yylex(YYSTYPE *lval, token_span_t *lloc, Lexer *lexer);
+void yyerror(token_span_t *lloc, Lexer *lexer, BaseAST *&ast, const char *s);
+
+// 位置是 token 的序号区间 (见 lexer.hpp), 不是行列号
+#define YYLLOC_DEFAULT(Cur, Rhs, N)                       \
+  do {                                                    \
+    if (N) {                                              \
+      (Cur).first = YYRHSLOC(Rhs, 1).first;               \
+      (Cur).last = YYRHSLOC(Rhs, N).last;                 \
+    } else {                                              \
+      (Cur).first = (Cur).last = YYRHSLOC(Rhs, 0).last;   \
+    }                                                     \
+  } while (0)
+}
+
+// 可重入的 parser 和 lexer: 没有全局的 yylval / yyin, 多个文件可以同时编译
+// lexer 的状态都在 Lexer 对象里 (见 lexer.hpp), 它扫描内存中的整个源文件
+%define api.pure full
+
+// 每个符号的位置是它覆盖的 token 区间, 函数缓存用它找到函数的 token 流
+%locations
+%define api.location.type {token_span_t}
+%lex-param { Lexer *lexer }
+
 // 定义 parser 函数和错误处理函数的附加参数
-// 我们需要返回一个字符串作为 AST, 所以我们把附加参数定义成字符串的智能指针
-// 解析完成后, 我们要手动修改这个参数, 把它设置成解析得到的字符串
-%parse-param { std::unique_ptr<BaseAST> &ast }
+// 我们需要返回 AST, 所以附加参数是 AST 根节点指针的引用 (节点都分配在 ctx->ast_arena 里)
+// 解析完成后, 我们要手动修改这个参数, 把它设置成解析得到的 AST
+%parse-param { Lexer *lexer } { BaseAST *&ast }
 
 // yylval 的定义, 我们把它定义成了一个联合体 (union)
-// 因为 token 的值有的是字符串指针, 有的是整数
-// 之前我们在 lexer 中用到的 str_val 和 int_val 就是在这里被定义的
-// 至于为什么要用字符串指针而不直接用 string 或者 unique_ptr<string>?
-// 请自行 STFW 在 union 里写一个带析构函数的类会出现什么情况
+// 因为 token 的值有的是标识符 id, 有的是运算符, 有的是整数
+// 之前我们在 lexer 中用到的 sym_val, op_val 和 int_val 就是在这里被定义的
+// 标识符在 lexer 里就被 interner 换成了整数 id, 所以 union 里不需要放字符串
 %union {
-  std::string *str_val;
+  sym_id_t sym_val;
+  op_t op_val;
+  btype_t type_val;
   int int_val;
   BaseAST *ast_val;
-  ExpBaseAST *exp_ast_val;
+  exp_id_t exp_val;  // 表达式在 ctx->exps 中的下标
   VecAST *vec_val;
 }
 
 // lexer 返回的所有 token 种类的声明
-// 注意 IDENT 和 INT_CONST 会返回 token 的值, 分别对应 str_val 和 int_val
+// 注意 IDENT, INT_CONST 和 RELOP/EQOP 会返回 token 的值, 分别对应 sym_val, int_val 和 op_val
 %token INT RETURN CONST IF ELSE WHILE BREAK CONTINUE VOID
-%token <str_val> IDENT
+%token <sym_val> IDENT
 %token <int_val> INT_CONST
-%token <str_val> RELOP EQOP ANDOP OROP
+%token <op_val> RELOP EQOP
+%token ANDOP OROP
 
 // 非终结符的类型定义
 %type <ast_val> FuncDef Decl ConstDecl ConstDef VarDecl VarDef Block CompUnitList
 %type <ast_val> BlockItem Stmt ClosedStmt OpenStmt SimpleStmt FuncFParam 
-%type <exp_ast_val> ConstExp ConstInitVal InitVal Exp UnaryExp PrimaryExp LVal
-%type <exp_ast_val> AddExp MulExp RelExp EqExp LAndExp LOrExp
-%type <int_val> Number
-%type <str_val> UnaryOp Type
-%type <vec_val> BlockItemList ConstDefList VarDefList FuncFParams FuncRParams
+%type <exp_val> ConstExp ConstInitVal InitVal Exp UnaryExp PrimaryExp LVal
+%type <exp_val> AddExp MulExp RelExp EqExp LAndExp LOrExp
+%type <int_val> Number FuncRParams
+%type <op_val> UnaryOp
+%type <type_val> Type
+%type <vec_val> BlockItemList ConstDefList VarDefList FuncFParams
 
 %%
 
 CompUnit
   : CompUnitList {
-    printf("CompUnit -> CompUnitList\n");
-    auto comp_unit = unique_ptr<CompUnitAST>((CompUnitAST*)($1));
-    ast = move(comp_unit);
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "CompUnit -> CompUnitList");
+    auto comp_unit = (CompUnitAST*)($1);
+    ast = comp_unit;
   }
   ;
 
 CompUnitList
   : FuncDef {
-    printf("CompUnitList -> FuncDef\n");
-    auto comp_unit = new CompUnitAST();
-    auto func_def = unique_ptr<BaseAST>($1);
-    comp_unit->func_def_list.push_back(move(func_def));
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "CompUnitList -> FuncDef");
+    auto comp_unit = ctx->ast_arena.New<CompUnitAST>();
+    auto func_def = $1;
+    comp_unit->func_def_list.push_back(func_def);
     $$ = comp_unit;
   }
   | Decl {
-    printf("CompUnitList -> Decl\n");
-    auto comp_unit = new CompUnitAST();
-    auto decl = unique_ptr<BaseAST>($1);
-    comp_unit->decl_list.push_back(move(decl));
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "CompUnitList -> Decl");
+    auto comp_unit = ctx->ast_arena.New<CompUnitAST>();
+    auto decl = $1;
+    comp_unit->decl_list.push_back(decl);
     $$ = comp_unit;
   }
   | CompUnitList FuncDef {
-    printf("CompUnitList -> CompUnitList FuncDef\n");
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "CompUnitList -> CompUnitList FuncDef");
     auto comp_unit = (CompUnitAST *)($1);
-    auto func_def = unique_ptr<BaseAST>($2);
-    comp_unit->func_def_list.push_back(move(func_def));
+    auto func_def = $2;
+    comp_unit->func_def_list.push_back(func_def);
     $$ = comp_unit;
   }
   | CompUnitList Decl {
-    printf("CompUnitList -> CompUnitList Decl\n");
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "CompUnitList -> CompUnitList Decl");
     auto comp_unit = (CompUnitAST *)($1);
-    auto decl = unique_ptr<BaseAST>($2);
-    comp_unit->decl_list.push_back(move(decl));
+    auto decl = $2;
+    comp_unit->decl_list.push_back(decl);
     $$ = comp_unit;
   }
   ;
 
 FuncDef
   : Type IDENT '(' ')' Block {
-    auto func_type = unique_ptr<string>($1);
-    auto ident = unique_ptr<string>($2);
-    auto block = unique_ptr<BaseAST>($5);
-    auto ast = new FuncDefAST(func_type, ident, block);
+    auto func_type = $1;
+    auto ident = $2;
+    auto block = $5;
+    auto ast = ctx->ast_arena.New<FuncDefAST>(func_type, ident, block);
+    ast->first_token = @$.first;
+    ast->last_token = @$.last;
     $$ = ast;
   }
   | Type IDENT '(' FuncFParams ')' Block {
-    auto func_type = unique_ptr<string>($1);
-    auto ident = unique_ptr<string>($2);
-    auto func_f_params = unique_ptr<VecAST>($4);
-    auto block = unique_ptr<BaseAST>($6);
-    auto ast = new FuncDefAST(func_type, ident, func_f_params, block);
+    auto func_type = $1;
+    auto ident = $2;
+    auto func_f_params = $4;
+    auto block = $6;
+    auto ast = ctx->ast_arena.New<FuncDefAST>(func_type, ident, func_f_params, block);
+    ast->first_token = @$.first;
+    ast->last_token = @$.last;
     $$ = ast;
   }
   ;
 
 Type
   : INT {
-    string *type = new string("int");
-    $$ = type;
+    $$ = TYPE_INT;
   }
   | VOID {
-    string *type = new string("void");
-    $$ = type;
+    $$ = TYPE_VOID;
   }
   ;
 
 FuncFParams
   : FuncFParam {
-    auto param = unique_ptr<BaseAST>($1);
-    auto ast = new VecAST();
+    auto param = $1;
+    auto ast = ctx->ast_arena.New<VecAST>(ctx->ast_arena);
     ast->push_back(param);
     $$ = ast;
   }
   | FuncFParams ',' FuncFParam {
     auto vec = $1;
-    auto param = unique_ptr<BaseAST>($3);
+    auto param = $3;
     vec->push_back(param);
   }
   ;
 
 FuncFParam
   : Type IDENT {
-    auto type = unique_ptr<string>($1);
-    auto ident = unique_ptr<string>($2);
-    auto ast = new FuncFParamAST(type, ident);
+    auto type = $1;
+    auto ident = $2;
+    auto ast = ctx->ast_arena.New<FuncFParamAST>(type, ident);
     $$ = ast;
   }
   ;
 
+// 实参先压到 ctx->exps 的参数栈上, 值是实参个数, 调用归约时一起取走
+// (嵌套的调用先归约, 所以用栈就够了)
 FuncRParams
   : Exp {
-    auto param = unique_ptr<BaseAST>($1);
-    auto ast = new VecAST();
-    ast->push_back(param);
-    $$ = ast;
+    ctx->exps.PushArg($1);
+    $$ = 1;
   }
   | FuncRParams ',' Exp {
-    auto vec = $1;
-    auto param = unique_ptr<BaseAST>($3);
-    vec->push_back(param);
+    ctx->exps.PushArg($3);
+    $$ = $1 + 1;
   }
   ;
 
 Block
   : '{' BlockItemList '}' {
-    auto blocks = unique_ptr<VecAST>($2);
-    auto ast = new BlockAST(blocks);
+    auto blocks = $2;
+    auto ast = ctx->ast_arena.New<BlockAST>(blocks);
     $$ = ast;
   }
 
 BlockItemList
   : {
-    auto vec = new VecAST();
+    auto vec = ctx->ast_arena.New<VecAST>(ctx->ast_arena);
     $$ = vec;
   }
   | BlockItemList BlockItem {
     auto vec = $1;
-    auto block_item = unique_ptr<BaseAST>($2);
+    auto block_item = $2;
     vec->push_back(block_item);
     $$ = vec;
   }
@@ -184,53 +214,53 @@ BlockItemList
 
 BlockItem
   : Stmt {
-    printf("------------BlockItem: Stmt------------\n");
-    auto stmt = unique_ptr<BaseAST>($1);
-    auto ast = new BlockItemAST(stmt, true);
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "------------BlockItem: Stmt------------");
+    auto stmt = $1;
+    auto ast = ctx->ast_arena.New<BlockItemAST>(stmt, true);
     $$ = ast;
   }
   | Decl {
-    printf("------------BlockItem: Decl------------\n");
-    auto decl = unique_ptr<BaseAST>($1);
-    auto ast = new BlockItemAST(decl, false);
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "------------BlockItem: Decl------------");
+    auto decl = $1;
+    auto ast = ctx->ast_arena.New<BlockItemAST>(decl, false);
     $$ = ast;
   }
   ;
 
 Decl
   : ConstDecl {
-    printf("------------Decl: ConstDecl------------\n");
-    auto const_decl = unique_ptr<BaseAST>($1);
-    auto ast = new DeclAST(const_decl, false);
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "------------Decl: ConstDecl------------");
+    auto const_decl = $1;
+    auto ast = ctx->ast_arena.New<DeclAST>(const_decl, false);
     $$ = ast;
   }
   | VarDecl {
-    printf("------------Decl: VarDecl------------\n");
-    auto var_decl = unique_ptr<BaseAST>($1);
-    auto ast = new DeclAST(var_decl, true);
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "------------Decl: VarDecl------------");
+    auto var_decl = $1;
+    auto ast = ctx->ast_arena.New<DeclAST>(var_decl, true);
     $$ = ast;
   }
   ;
 
 ConstDecl
   : CONST Type ConstDefList ';' {
-    auto btype = unique_ptr<string>($2);
-    auto const_def_list = unique_ptr<VecAST>($3);
-    auto ast = new ConstDeclAST(btype, const_def_list);
+    auto btype = $2;
+    auto const_def_list = $3;
+    auto ast = ctx->ast_arena.New<ConstDeclAST>(btype, const_def_list);
     $$ = ast;
   }
   ;
 
 ConstDefList
   : ConstDef {
-    auto vec = new VecAST();
-    auto const_def = unique_ptr<BaseAST>($1);
+    auto vec = ctx->ast_arena.New<VecAST>(ctx->ast_arena);
+    auto const_def = $1;
     vec->push_back(const_def);
     $$ = vec;
   }
   | ConstDefList ',' ConstDef {
     auto vec = $1;
-    auto const_def = unique_ptr<BaseAST>($3);
+    auto const_def = $3;
     vec->push_back(const_def);
     $$ = vec;
   }
@@ -238,49 +268,45 @@ ConstDefList
 
 ConstDef
   : IDENT '=' ConstInitVal {
-    auto ident = unique_ptr<string>($1);
-    auto const_init_val = unique_ptr<ExpBaseAST>($3);
-    auto ast = new ConstDefAST(ident, const_init_val);
+    auto ident = $1;
+    auto const_init_val = $3;
+    auto ast = ctx->ast_arena.New<ConstDefAST>(ident, const_init_val);
     $$ = ast;
   }
   ;
 
 ConstInitVal
   : ConstExp {
-    auto const_exp = unique_ptr<ExpBaseAST>($1);
-    auto ast = new ConstInitValAST(const_exp);
-    $$ = ast;
+    $$ = $1;
   }
   ;
 
 ConstExp
   : Exp {
-    auto exp = unique_ptr<ExpBaseAST>($1);
-    auto ast = new ConstExpAST(exp);
-    $$ = ast;
+    $$ = $1;
   }
   ;
 
 VarDecl
   : Type VarDefList ';' {
-    auto btype = unique_ptr<string>($1);
-    printf("VarDecl -> %s VarDefList\n", btype->c_str());
-    auto var_def_list = unique_ptr<VecAST>($2);
-    auto ast = new VarDeclAST(btype, var_def_list);
+    auto btype = $1;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "VarDecl -> %s VarDefList", btype == TYPE_INT ? "int" : "void");
+    auto var_def_list = $2;
+    auto ast = ctx->ast_arena.New<VarDeclAST>(btype, var_def_list);
     $$ = ast;
   }
   ;
 
 VarDefList
   : VarDef {
-    auto vec = new VecAST();
-    auto var_def = unique_ptr<BaseAST>($1);
+    auto vec = ctx->ast_arena.New<VecAST>(ctx->ast_arena);
+    auto var_def = $1;
     vec->push_back(var_def);
     $$ = vec;
   }
   | VarDefList ',' VarDef {
     auto vec = $1;
-    auto var_def = unique_ptr<BaseAST>($3);
+    auto var_def = $3;
     vec->push_back(var_def);
     $$ = vec;
   }
@@ -288,26 +314,24 @@ VarDefList
 
 VarDef
   : IDENT {
-    auto ident = unique_ptr<string>($1);
-    printf("VarDef -> %s\n", ident->c_str());
-    auto ast = new VarDefAST(ident);
+    auto ident = $1;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "VarDef -> %s", ctx->interner.Name(ident).c_str());
+    auto ast = ctx->ast_arena.New<VarDefAST>(ident);
     $$ = ast;
   }
   | IDENT '=' InitVal {
-    auto ident = unique_ptr<string>($1);
-    printf("VarDef -> %s = InitVal", ident->c_str());
-    auto init_val = unique_ptr<ExpBaseAST>($3);
-    auto ast = new VarDefAST(ident, init_val);
+    auto ident = $1;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "VarDef -> %s = InitVal", ctx->interner.Name(ident).c_str());
+    auto init_val = $3;
+    auto ast = ctx->ast_arena.New<VarDefAST>(ident, init_val);
     $$ = ast;
   }
   ;
 
 InitVal
   : Exp {
-    printf("InitVal -> Exp\n");
-    auto exp = unique_ptr<ExpBaseAST>($1);
-    auto ast = new InitValAST(exp);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "InitVal -> Exp");
+    $$ = $1;
   }
   ;
 
@@ -319,32 +343,32 @@ Stmt
 ClosedStmt
   : SimpleStmt
   | IF '(' Exp ')' ClosedStmt ELSE ClosedStmt {
-    auto exp = unique_ptr<ExpBaseAST>($3);
-    auto if_stmt = unique_ptr<BaseAST>($5);
-    auto else_stmt = unique_ptr<BaseAST>($7);
-    auto ast = new IfAST(exp, if_stmt, else_stmt);
+    auto exp = $3;
+    auto if_stmt = $5;
+    auto else_stmt = $7;
+    auto ast = ctx->ast_arena.New<IfAST>(exp, if_stmt, else_stmt);
     $$ = ast;
   }
   | WHILE '(' Exp ')' ClosedStmt {
-    auto cond = unique_ptr<ExpBaseAST>($3);
-    auto body = unique_ptr<BaseAST>($5);
-    auto ast = new WhileAST(cond, body);
+    auto cond = $3;
+    auto body = $5;
+    auto ast = ctx->ast_arena.New<WhileAST>(cond, body);
     $$ = ast;
   }
   ;
 
 OpenStmt
   : IF '(' Exp ')' Stmt {
-    auto exp = unique_ptr<ExpBaseAST>($3);
-    auto if_stmt = unique_ptr<BaseAST>($5);
-    auto ast = new IfAST(exp, if_stmt);
+    auto exp = $3;
+    auto if_stmt = $5;
+    auto ast = ctx->ast_arena.New<IfAST>(exp, if_stmt);
     $$ = ast;
   }
   | IF '(' Exp ')' ClosedStmt ELSE OpenStmt {
-    auto exp = unique_ptr<ExpBaseAST>($3);
-    auto if_stmt = unique_ptr<BaseAST>($5);
-    auto else_stmt = unique_ptr<BaseAST>($7);
-    auto ast = new IfAST(exp, if_stmt, else_stmt);
+    auto exp = $3;
+    auto if_stmt = $5;
+    auto else_stmt = $7;
+    auto ast = ctx->ast_arena.New<IfAST>(exp, if_stmt, else_stmt);
     $$ = ast;
   }
   | WHILE '(' Exp ')' OpenStmt {
@@ -354,255 +378,222 @@ OpenStmt
 
 SimpleStmt
   : RETURN Exp ';' {
-    printf("Stmt -> return Exp\n");
-    auto exp = unique_ptr<ExpBaseAST>($2);
-    auto ast = new RetAST(exp);
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "Stmt -> return Exp");
+    auto exp = $2;
+    auto ast = ctx->ast_arena.New<RetAST>(exp);
     $$ = ast;
   }
   | RETURN ';' {
-    printf("Stmt -> return\n");
-    auto ast = new RetAST();
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "Stmt -> return");
+    auto ast = ctx->ast_arena.New<RetAST>();
     $$ = ast;
   }
   | LVal '=' Exp ';' {
     // assign
-    printf("Stmt -> LVal = Exp\n");
-    auto lval = unique_ptr<ExpBaseAST>($1);
-    // cast lval to LValAST
-    auto lval_ast = static_cast<LValAST*>(lval.get());
-    lval_ast->at_left = true;
-    auto exp = unique_ptr<ExpBaseAST>($3);
-    auto ast = new AssignAST(lval, exp);
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "Stmt -> LVal = Exp");
+    auto lval = $1;
+    ctx->exps.SetAtLeft(lval);
+    auto exp = $3;
+    auto ast = ctx->ast_arena.New<AssignAST>(lval, exp);
     $$ = ast;
   }
   | Block {
-    printf("Stmt -> Block\n");
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "Stmt -> Block");
     // do nothing
     $$ = $1;
   }
   | Exp ';' {
-    printf("Stmt -> Exp;\n");
-    auto exp = unique_ptr<ExpBaseAST>($1);
-    auto ast = new StmtAST(exp);
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "Stmt -> Exp;");
+    auto exp = $1;
+    auto ast = ctx->ast_arena.New<StmtAST>(exp);
     $$ = ast;
   }
   | BREAK {
-    printf("Stmt -> break\n");
-    auto ast = new BreakAST();
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "Stmt -> break");
+    auto ast = ctx->ast_arena.New<BreakAST>();
     $$ = ast;
   }
   | CONTINUE {
-    printf("Stmt -> continue\n");
-    auto ast = new ContinueAST();
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "Stmt -> continue");
+    auto ast = ctx->ast_arena.New<ContinueAST>();
     $$ = ast;
   }
   | ';' {
-    printf("Stmt -> ;\n");
-    auto ast = new StmtAST();
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "Stmt -> ;");
+    auto ast = ctx->ast_arena.New<StmtAST>();
     $$ = ast;
   }
   ;
 
+// 表达式里只有带运算符的产生式才建节点, 只有一个子节点的产生式 (Exp -> LOrExp,
+// AddExp -> MulExp, PrimaryExp -> ( Exp ) 等) 直接把子节点传上去
+// 所以单独的数字或变量就是一个节点, 而不是九层的单链
 Exp
   : LOrExp {
-    printf("Exp -> LOrExp\n");
-    auto lor = unique_ptr<ExpBaseAST>($1);
-    auto ast = new ExpAST(lor);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "Exp -> LOrExp");
+    $$ = $1;
   }
   ;
 
 UnaryExp
   : PrimaryExp {
-    printf("UnaryExp -> PrimaryExp\n");
-    auto primary = unique_ptr<ExpBaseAST>($1);
-    auto ast = new UnaryAST(primary);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "UnaryExp -> PrimaryExp");
+    $$ = $1;
   }
   | UnaryOp UnaryExp {
-    printf("UnaryExp -> UnaryOp(%s) UnaryExp\n", $1->c_str());
-    auto unary = unique_ptr<ExpBaseAST>($2);
-    auto ast = new UnaryAST($1, unary);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "UnaryExp -> UnaryOp(%s) UnaryExp", op_str($1));
+    auto unary = $2;
+    $$ = ctx->exps.Unary($1, unary);
   }
   | IDENT '(' ')' {
     // func call
-    printf("UnaryExp -> %s()\n", $1->c_str());
-    auto ident = unique_ptr<string>($1);
-    auto ast = new FuncCallAST(ident);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "UnaryExp -> %s()", ctx->interner.Name($1).c_str());
+    auto ident = $1;
+    $$ = ctx->exps.Call(ident, 0);
   }
   | IDENT '(' FuncRParams ')' {
     // func call with params
-    printf("UnaryExp -> %s(params...)\n", $1->c_str());
-    auto ident = unique_ptr<string>($1);
-    auto params = unique_ptr<VecAST>($3);
-    auto ast = new FuncCallAST(ident, params);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "UnaryExp -> %s(params...)", ctx->interner.Name($1).c_str());
+    auto ident = $1;
+    auto argc = $3;
+    $$ = ctx->exps.Call(ident, argc);
   }
   ;
 
 PrimaryExp
   : '(' Exp ')' {
-    printf("PrimaryExp -> ( Exp )\n");
-    auto exp = unique_ptr<ExpBaseAST>($2);
-    auto ast = new PrimaryAST(exp, false);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "PrimaryExp -> ( Exp )");
+    $$ = $2;
   }
   | Number {
-    printf("PrimaryExp -> Number %d\n", $1);
-    auto ast = new PrimaryAST($1);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "PrimaryExp -> Number %d", $1);
+    $$ = ctx->exps.Number($1);
   }
   | LVal {
-    printf("PrimaryExp -> LVal\n");
-    auto lval = unique_ptr<ExpBaseAST>($1);
-    auto ast = new PrimaryAST(lval, true);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "PrimaryExp -> LVal");
+    $$ = $1;
   }
   ;
 
 LVal
   : IDENT {
-    printf("LVal -> IDENT %s\n", $1->c_str());
-    auto ident = unique_ptr<string>($1);
-    auto ast = new LValAST(ident);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "LVal -> IDENT %s", ctx->interner.Name($1).c_str());
+    auto ident = $1;
+    $$ = ctx->exps.LVal(ident);
   }
   ;
 
 UnaryOp
   : '+' {
-    string *op = new string("+");
-    printf("UnaryOp -> +\n");
-    $$ = op;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "UnaryOp -> +");
+    $$ = OP_ADD;
   }
   | '-' {
-    string *op = new string("-");
-    printf("UnaryOp -> -\n");
-    $$ = op;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "UnaryOp -> -");
+    $$ = OP_SUB;
   }
   | '!' {
-    string *op = new string("!");
-    printf("UnaryOp -> !\n");
-    $$ = op;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "UnaryOp -> !");
+    $$ = OP_NOT;
   }
   ;
 
 MulExp
   : UnaryExp {
-    printf("MulExp -> UnaryExp\n");
-    auto unary = unique_ptr<ExpBaseAST>($1);
-    auto ast = new MulAST(unary);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "MulExp -> UnaryExp");
+    $$ = $1;
   }
   | MulExp '*' UnaryExp {
-    printf("MulExp -> MulExp * UnaryExp\n");
-    auto mul = unique_ptr<ExpBaseAST>($1);
-    auto unary = unique_ptr<ExpBaseAST>($3);
-    auto ast = new MulAST("*", mul, unary);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "MulExp -> MulExp * UnaryExp");
+    auto mul = $1;
+    auto unary = $3;
+    $$ = ctx->exps.Binary(OP_MUL, mul, unary);
   }
   | MulExp '/' UnaryExp {
-    printf("MulExp -> MulExp / UnaryExp\n");
-    auto mul = unique_ptr<ExpBaseAST>($1);
-    auto unary = unique_ptr<ExpBaseAST>($3);
-    auto ast = new MulAST("/", mul, unary);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "MulExp -> MulExp / UnaryExp");
+    auto mul = $1;
+    auto unary = $3;
+    $$ = ctx->exps.Binary(OP_DIV, mul, unary);
   }
   | MulExp '%' UnaryExp {
-    printf("MulExp -> MulExp %% UnaryExp\n");
-    auto mul = unique_ptr<ExpBaseAST>($1);
-    auto unary = unique_ptr<ExpBaseAST>($3);
-    auto ast = new MulAST("%", mul, unary);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "MulExp -> MulExp %% UnaryExp");
+    auto mul = $1;
+    auto unary = $3;
+    $$ = ctx->exps.Binary(OP_MOD, mul, unary);
   }
   ;
 
 AddExp
   : MulExp {
-    printf("AddExp -> MulExp\n");
-    auto mul = unique_ptr<ExpBaseAST>($1);
-    auto ast = new AddAST(mul);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "AddExp -> MulExp");
+    $$ = $1;
   }
   | AddExp '+' MulExp {
-    printf("AddExp -> AddExp + MulExp\n");
-    auto add = unique_ptr<ExpBaseAST>($1);
-    auto mul = unique_ptr<ExpBaseAST>($3);
-    auto ast = new AddAST("+", add, mul);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "AddExp -> AddExp + MulExp");
+    auto add = $1;
+    auto mul = $3;
+    $$ = ctx->exps.Binary(OP_ADD, add, mul);
   }
   | AddExp '-' MulExp {
-    printf("AddExp -> AddExp - MulExp\n");
-    auto add = unique_ptr<ExpBaseAST>($1);
-    auto mul = unique_ptr<ExpBaseAST>($3);
-    auto ast = new AddAST("-", add, mul);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "AddExp -> AddExp - MulExp");
+    auto add = $1;
+    auto mul = $3;
+    $$ = ctx->exps.Binary(OP_SUB, add, mul);
   }
   ;
 
 RelExp
   : AddExp {
-    printf("RelExp -> AddExp\n");
-    auto add = unique_ptr<ExpBaseAST>($1);
-    auto ast = new RelAST(add);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "RelExp -> AddExp");
+    $$ = $1;
   }
   | RelExp RELOP AddExp {
-    printf("RelExp -> RelExp %s AddExp\n", $2->c_str());
-    auto rel = unique_ptr<ExpBaseAST>($1);
-    auto add = unique_ptr<ExpBaseAST>($3);
-    auto ast = new RelAST($2, rel, add);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "RelExp -> RelExp %s AddExp", op_str($2));
+    auto rel = $1;
+    auto add = $3;
+    $$ = ctx->exps.Binary($2, rel, add);
   }
   ;
 
 EqExp
   : RelExp {
-    printf("EqExp -> RelExp\n");
-    auto rel = unique_ptr<ExpBaseAST>($1);
-    auto ast = new EqAST(rel);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "EqExp -> RelExp");
+    $$ = $1;
   }
   | EqExp EQOP RelExp {
-    printf("EqExp -> EqExp %s RelExp\n", $2->c_str());
-    auto eq = unique_ptr<ExpBaseAST>($1);
-    auto rel = unique_ptr<ExpBaseAST>($3);
-    auto ast = new EqAST($2, eq, rel);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "EqExp -> EqExp %s RelExp", op_str($2));
+    auto eq = $1;
+    auto rel = $3;
+    $$ = ctx->exps.Binary($2, eq, rel);
   }
   ;
 
 LAndExp
   : EqExp {
-    printf("LAndExp -> EqExp\n");
-    auto eq = unique_ptr<ExpBaseAST>($1);
-    auto ast = new LAndAST(eq);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "LAndExp -> EqExp");
+    $$ = $1;
   }
-  | LAndExp ANDOP EqExp {
-    printf("LAndExp -> LAndExp && EqExp\n");
-    auto land = unique_ptr<ExpBaseAST>($1);
-    auto eq = unique_ptr<ExpBaseAST>($3);
-    auto ast = new LAndAST(land, eq);
-    $$ = ast;
+  | LAndExp ANDOP {
+    // 右操作数之前放一个 EXP_RHS 节点, 短路跳转从这里生成
+    $<exp_val>$ = ctx->exps.LogicRhs($1);
+  } EqExp {
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "LAndExp -> LAndExp && EqExp");
+    auto eq = $4;
+    $$ = ctx->exps.Logic(EXP_AND, $<exp_val>3, eq);
   }
   ;
 
 LOrExp
   : LAndExp {
-    printf("LOrExp -> LAndExp\n");
-    auto land = unique_ptr<ExpBaseAST>($1);
-    auto ast = new LOrAST(land);
-    $$ = ast;
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "LOrExp -> LAndExp");
+    $$ = $1;
   }
-  | LOrExp OROP LAndExp {
-    printf("LOrExp -> LOrExp || LAndExp\n");
-    auto lor = unique_ptr<ExpBaseAST>($1);
-    auto land = unique_ptr<ExpBaseAST>($3);
-    auto ast = new LOrAST(lor, land);
-    $$ = ast;
+  | LOrExp OROP {
+    $<exp_val>$ = ctx->exps.LogicRhs($1);
+  } LAndExp {
+    TRACE(TRACE_PARSE, TRACE_VERBOSE, "LOrExp -> LOrExp || LAndExp");
+    auto land = $4;
+    $$ = ctx->exps.Logic(EXP_OR, $<exp_val>3, land);
   }
   ;
 
@@ -613,6 +604,6 @@ Number
 
 // 定义错误处理函数, 其中第二个参数是错误信息
 // parser 如果发生错误 (例如输入的程序出现了语法错误), 就会调用这个函数
-void yyerror(unique_ptr<BaseAST> &ast, const char *s) {
+void yyerror(token_span_t *lloc, Lexer *lexer, BaseAST *&ast, const char *s) {
   cerr << "error: " << s << endl;
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include <timeline.hpp>
+
+#include <atomic>
+#include <cstring>
+
+static atomic<int> thread_cnt{0};
+static thread_local int thread_id = -1;  // small ids read better in a trace viewer
+
+uint64_t Timeline::Now() const {
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+void Timeline::Add(const char *phase, string_view detail, uint64_t begin, uint64_t end) {
+  if (thread_id < 0)
+    thread_id = thread_cnt++;
+  lock_guard<mutex> guard(lock);
+  events.push_back({phase, string(detail), thread_id, begin, end - begin});
+}
+
+/**
+ * @brief print a table of every phase: how often it ran, its total time
+ * (summed over threads) and its longest single run
+ */
+void Timeline::Report(FILE *out) {
+  struct total_t {
+    const char *phase;
+    size_t count;
+    uint64_t sum;
+    uint64_t max;
+  };
+
+  vector<total_t> totals;  // in order of first appearance
+  {
+    lock_guard<mutex> guard(lock);
+    for (auto &event : events) {
+      total_t *total = nullptr;
+      for (auto &t : totals)
+        if (!strcmp(t.phase, event.phase))
+          total = &t;
+      if (!total) {
+        totals.push_back({event.phase, 0, 0, 0});
+        total = &totals.back();
+      }
+      total->count++;
+      total->sum += event.dur;
+      if (event.dur > total->max)
+        total->max = event.dur;
+    }
+  }
+
+  fprintf(out, "%-12s %8s %12s %12s\n", "phase", "count", "total(ms)", "max(ms)");
+  for (auto &t : totals)
+    fprintf(out, "%-12s %8zu %12.3f %12.3f\n", t.phase, t.count, t.sum / 1e6, t.max / 1e6);
+  fprintf(out, "%-12s %8s %12.3f\n", "wall", "", Now() / 1e6);
+}
+
+static void WriteJsonString(FILE *out, const string &s) {
+  fputc('"', out);
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      fprintf(out, "\\%c", c);
+    else if ((unsigned char)c < 0x20)
+      fprintf(out, "\\u%04x", c);
+    else
+      fputc(c, out);
+  }
+  fputc('"', out);
+}
+
+/**
+ * @brief write all events as complete ("X") events of the Chrome
+ * trace_event format, loadable in chrome://tracing or Perfetto
+ *
+ * @return bool whether the file is written
+ */
+bool Timeline::WriteTrace(const char *path) {
+  FILE *out = fopen(path, "w");
+  if (!out)
+    return false;
+
+  lock_guard<mutex> guard(lock);
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+  for (size_t i = 0; i < events.size(); ++i) {
+    auto &event = events[i];
+    fprintf(out, "{\"name\":\"%s\",\"cat\":\"compile\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"detail\":",
+            event.phase, event.tid, event.begin / 1e3, event.dur / 1e3);
+    WriteJsonString(out, event.detail);
+    fputs(i + 1 < events.size() ? "}},\n" : "}}\n", out);
+  }
+  fputs("]}\n", out);
+  return fclose(out) == 0;
+}
@@ -0,0 +1,61 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// timed phases of all compilations of the process (-time-report, -trace)
+// every thread adds its own events, they are summed up per phase by
+// Report() and written as Chrome trace events by WriteTrace()
+class Timeline {
+ private:
+  struct event_t {
+    const char *phase;
+    string detail;  // file or function
+    int tid;
+    uint64_t begin;  // ns since the timeline started
+    uint64_t dur;
+  };
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  mutex lock;
+  vector<event_t> events;
+
+ public:
+  uint64_t Now() const;
+  void Add(const char *phase, string_view detail, uint64_t begin, uint64_t end);
+
+  void Report(FILE *out);
+  bool WriteTrace(const char *path);
+};
+
+// times its own lifetime as one event of phase, nothing if timeline is null
+class TimeScope {
+ private:
+  Timeline *timeline;
+  const char *phase;
+  string_view detail;  // must outlive the scope
+  uint64_t begin = 0;
+
+ public:
+  TimeScope(Timeline *timeline, const char *phase, string_view detail = {})
+      : timeline(timeline), phase(phase), detail(detail) {
+    if (timeline)
+      begin = timeline->Now();
+  }
+  TimeScope(const TimeScope&) = delete;
+  TimeScope& operator=(const TimeScope&) = delete;
+  ~TimeScope() {
+    if (timeline)
+      timeline->Add(phase, detail, begin, timeline->Now());
+  }
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include <trace.hpp>
+
+#ifdef ENABLE_TRACE
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int trace_level[TRACE_CAT_NUM];
+
+static const char* cat_names[TRACE_CAT_NUM] = {
+  "lex", "parse", "symtab", "irgen", "backend", "mem", "server", "cache", "batch",
+};
+
+/**
+ * @brief read SYSY_TRACE, a comma separated list of <category>=<level>
+ * ("all" sets every category, a missing level means TRACE_DEBUG)
+ */
+void TraceInit() {
+  const char* env = getenv("SYSY_TRACE");
+  if (!env)
+    return;
+
+  char* spec = strdup(env);
+  for (char* item = strtok(spec, ","); item; item = strtok(nullptr, ",")) {
+    char* eq = strchr(item, '=');
+    int level = TRACE_DEBUG;
+    if (eq) {
+      *eq = '\0';
+      level = atoi(eq + 1);
+    }
+    bool found = false;
+    for (int i = 0; i < TRACE_CAT_NUM; ++i) {
+      if (!strcmp(item, "all") || !strcmp(item, cat_names[i])) {
+        trace_level[i] = level;
+        found = true;
+      }
+    }
+    if (!found)
+      fprintf(stderr, "[trace] unknown category '%s'\n", item);
+  }
+  free(spec);
+}
+
+void TracePrint(trace_cat_t cat, const char* fmt, ...) {
+  fprintf(stderr, "[%s] ", cat_names[cat]);
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+#endif
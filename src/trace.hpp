@@ -0,0 +1,52 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// leveled debug tracing to stderr
+// only compiled in with -DENABLE_TRACE (debug build), otherwise TRACE
+// expands to nothing and its arguments are never evaluated
+// at runtime it is switched by env SYSY_TRACE, e.g. "parse=3,symtab=2" or "all=1"
+
+typedef enum {
+  TRACE_LEX,
+  TRACE_PARSE,
+  TRACE_SYMTAB,
+  TRACE_IRGEN,
+  TRACE_BACKEND,
+  TRACE_MEM,
+  TRACE_SERVER,
+  TRACE_CACHE,
+  TRACE_BATCH,
+  TRACE_CAT_NUM,
+} trace_cat_t;
+
+typedef enum {
+  TRACE_OFF = 0,
+  TRACE_INFO = 1,     // once per phase / function
+  TRACE_DEBUG = 2,    // once per statement / instruction
+  TRACE_VERBOSE = 3,  // once per token / reduction / node
+} trace_level_t;
+
+#ifdef ENABLE_TRACE
+
+extern int trace_level[TRACE_CAT_NUM];
+
+void TraceInit();
+void TracePrint(trace_cat_t cat, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define TRACE(cat, level, ...)                  \
+  do {                                          \
+    if (trace_level[cat] >= (level))            \
+      TracePrint(cat, __VA_ARGS__);             \
+  } while (0)
+
+#else
+
+inline void TraceInit() {}
+
+#define TRACE(cat, level, ...) \
+  do {                         \
+  } while (0)
+
+#endif
+
+#endif
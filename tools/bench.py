@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+# compile-throughput benchmark over the synthetic programs of gensysy.py
+#   bench.py <compiler> [options]
+# every shape is compiled at doubling sizes, each run reports lines per
+# second and peak RSS, and the growth of time between two sizes is
+# checked: a slope (log time / log size) well above 1 is flagged as
+# super-linear. Every run passes -time-report, the time of the main phases
+# is printed next to the total so a regression can be traced to its phase
+
+import argparse
+import math
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gensysy
+
+# shape -> (first size, modes it is supported in)
+SHAPES = {
+    'add': (16000, ['-koopa', '-riscv']),
+    'lor': (2000, ['-koopa', '-riscv']),
+    'block': (500, ['-koopa', '-riscv']),
+    'while': (500, ['-koopa', '-riscv']),
+    'funcs': (1000, ['-koopa', '-riscv']),
+    'globals': (2000, ['-koopa']),
+    'params': (64, ['-koopa', '-riscv']),
+}
+
+# column -> phases of -time-report summed in it
+PHASES = {
+    'parse': ['parse'],
+    'lower': ['lower'],
+    'mem2reg': ['mem2reg'],
+    'backend': ['build raw', 'riscv'],
+    'write': ['write'],
+}
+
+SLOPE_LIMIT = 1.5   # time grows faster than size^1.5
+NOISE_FLOOR = 0.05  # seconds, faster runs are too noisy for a slope
+
+
+def phase_times(report):
+    """milliseconds of every column of PHASES in a -time-report, None if not run"""
+    totals = {}
+    for line in report.splitlines():
+        # <phase> <count> <total> <max>, a phase name may have spaces
+        fields = line.rsplit(None, 3)
+        if len(fields) == 4 and fields[1].isdigit():
+            totals[fields[0]] = float(fields[2])
+    times = {}
+    for column, phases in PHASES.items():
+        ran = [totals[phase] for phase in phases if phase in totals]
+        times[column] = sum(ran) if ran else None
+    return times
+
+
+def run(compiler, mode, src, out, report, jobs, timeout):
+    """compile once, return (seconds, peak RSS in KB, phase times, status)"""
+    cmd = [compiler, mode, src, '-o', out, '-time-report']
+    if jobs:
+        cmd += ['-j', str(jobs)]
+    start = time.perf_counter()
+    with open(report, 'w') as err:
+        proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=err)
+    deadline = start + timeout
+    while True:
+        pid, status, usage = os.wait4(proc.pid, os.WNOHANG)
+        if pid:
+            break
+        if time.perf_counter() > deadline:
+            proc.kill()
+            os.wait4(proc.pid, 0)
+            return timeout, 0, {}, 'TIMEOUT'
+        time.sleep(0.001)
+    seconds = time.perf_counter() - start
+    with open(report) as err:
+        times = phase_times(err.read())
+    if os.WIFSIGNALED(status):
+        return seconds, usage.ru_maxrss, times, 'CRASH'
+    if os.WEXITSTATUS(status):
+        return seconds, usage.ru_maxrss, times, 'FAIL'
+    return seconds, usage.ru_maxrss, times, 'ok'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='SysY compiler throughput benchmark')
+    parser.add_argument('compiler')
+    parser.add_argument('--shapes', default=','.join(SHAPES), help='comma separated shapes')
+    parser.add_argument('--modes', default='-koopa,-riscv')
+    parser.add_argument('--scale', type=float, default=1.0, help='multiplies the first size of every shape')
+    parser.add_argument('--steps', type=int, default=4, help='sizes per shape, each twice the one before')
+    parser.add_argument('--jobs', type=int, default=0, help='passed as -j, 0 keeps the default')
+    parser.add_argument('--timeout', type=float, default=60.0, help='seconds per compile')
+    parser.add_argument('--strict', action='store_true', help='exit 1 on any flag')
+    args = parser.parse_args()
+
+    flags = []
+    phase_header = ' '.join(f'{column + "(ms)":>12}' for column in PHASES)
+    print(f'{"shape":8} {"mode":7} {"n":>8} {"lines":>8} {"time(s)":>9} {"lines/s":>10} {"rss(MB)":>8} '
+          f'{phase_header} {"slope":>6}  status')
+    with tempfile.TemporaryDirectory() as tmp:
+        src, out = os.path.join(tmp, 'bench.c'), os.path.join(tmp, 'bench.out')
+        report = os.path.join(tmp, 'bench.report')
+        for shape in args.shapes.split(','):
+            first, modes = SHAPES[shape]
+            for mode in args.modes.split(','):
+                if mode not in modes:
+                    continue
+                prev = None  # (lines, seconds) of the size before
+                for step in range(args.steps):
+                    n = max(1, int(first * args.scale)) << step
+                    program = gensysy.generate(shape, n)
+                    with open(src, 'w') as f:
+                        f.write(program)
+                    lines = program.count('\n')
+                    seconds, rss, times, status = run(args.compiler, mode, src, out, report,
+                                                      args.jobs, args.timeout)
+
+                    slope = ''
+                    if status == 'ok' and prev and seconds > NOISE_FLOOR and prev[1] > 0:
+                        k = math.log(seconds / prev[1]) / math.log(lines / prev[0])
+                        slope = f'{k:.2f}'
+                        if k > SLOPE_LIMIT:
+                            status = 'SUPERLINEAR'
+                    phase_cols = ' '.join('{:>12}'.format('-' if times.get(column) is None
+                                                          else f'{times[column]:.1f}')
+                                          for column in PHASES)
+                    print(f'{shape:8} {mode:7} {n:8} {lines:8} {seconds:9.3f} {lines / seconds:10.0f} '
+                          f'{rss / 1024:8.1f} {phase_cols} {slope:>6}  {status}', flush=True)
+                    if status != 'ok':
+                        flags.append(f'{shape} {mode} n={n}: {status}')
+                    if status in ('TIMEOUT', 'CRASH', 'FAIL'):
+                        break
+                    prev = (lines, seconds)
+
+    if flags:
+        print('\nflagged:')
+        for flag in flags:
+            print('  ' + flag)
+    return 1 if flags and args.strict else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
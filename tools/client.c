@@ -0,0 +1,124 @@
+// client of the compile server (compiler -server <socket>), takes the
+// arguments of the compiler itself:
+//   client <socket> <mode> <input> -o <output>
+// exit status is 0 on success, 1 on a rejected source or a broken server
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int ReadFull(int fd, char *p, size_t n) {
+  while (n > 0) {
+    ssize_t got = read(fd, p, n);
+    if (got <= 0)
+      return 0;
+    p += got;
+    n -= got;
+  }
+  return 1;
+}
+
+static int WriteFull(int fd, const char *p, size_t n) {
+  while (n > 0) {
+    ssize_t put = write(fd, p, n);
+    if (put <= 0)
+      return 0;
+    p += put;
+    n -= put;
+  }
+  return 1;
+}
+
+static char *ReadFile(const char *path, size_t *len) {
+  FILE *in = fopen(path, "rb");
+  if (!in)
+    return NULL;
+  fseek(in, 0, SEEK_END);
+  long size = ftell(in);
+  fseek(in, 0, SEEK_SET);
+  char *buf = malloc(size > 0 ? size : 1);
+  *len = fread(buf, 1, size, in);
+  fclose(in);
+  return buf;
+}
+
+static int Connect(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return -1;
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 6 || strcmp(argv[4], "-o")) {
+    fprintf(stderr, "usage: %s <socket> <mode> <input> -o <output>\n", argv[0]);
+    return 1;
+  }
+
+  size_t len;
+  char *src = ReadFile(argv[3], &len);
+  if (!src) {
+    perror(argv[3]);
+    return 1;
+  }
+  int fd = Connect(argv[1]);
+  if (fd < 0) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  // request
+  char header[64];
+  int n = snprintf(header, sizeof(header), "%s %zu\n", argv[2], len);
+  if (!WriteFull(fd, header, n) || !WriteFull(fd, src, len)) {
+    fprintf(stderr, "server closed the connection\n");
+    return 1;
+  }
+  free(src);
+
+  // response header, then the body
+  n = 0;
+  while (n < (int)sizeof(header) - 1 && ReadFull(fd, header + n, 1))
+    if (header[n++] == '\n')
+      break;
+  header[n] = '\0';
+  int status;
+  size_t size;
+  if (sscanf(header, "%d %zu", &status, &size) != 2) {
+    fprintf(stderr, "bad response\n");
+    return 1;
+  }
+  char *body = malloc(size ? size : 1);
+  if (!ReadFull(fd, body, size)) {
+    fprintf(stderr, "bad response\n");
+    return 1;
+  }
+  close(fd);
+
+  if (status != 0) {
+    fprintf(stderr, "error: %.*s\n", (int)size, body);
+    return 1;
+  }
+  FILE *out = fopen(argv[5], "wb");
+  if (!out || fwrite(body, 1, size, out) != size) {
+    perror(argv[5]);
+    return 1;
+  }
+  fclose(out);
+  free(body);
+  return 0;
+}
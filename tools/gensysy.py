@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+# synthetic SysY stress programs for the benchmark (bench.py)
+#   gensysy.py <shape> <n>    program of the given shape and size on stdout
+#
+# shapes (n is the size knob):
+#   add      one AddExp of n terms
+#   lor      one LOrExp of n terms in an if condition
+#   block    n nested blocks, each shadowing a variable
+#   while    n nested while loops
+#   funcs    n functions, each calling the one before
+#   globals  n global variables summed in main (koopa only for now)
+#   params   a function with n parameters and a call to it
+
+import sys
+
+TERMS_PER_LINE = 16
+
+
+def chain(op, term, n):
+    """n terms joined by op, TERMS_PER_LINE per line"""
+    lines = []
+    for i in range(0, n, TERMS_PER_LINE):
+        lines.append('    ' + f' {op} '.join(term(j) for j in range(i, min(n, i + TERMS_PER_LINE))))
+    return f' {op}\n'.join(lines)
+
+
+def gen_add(n):
+    return ('int main() {\n  int a = 1;\n  return\n'
+            + chain('+', lambda i: 'a' if i % 2 else str(i % 100), n) + ';\n}\n')
+
+
+def gen_lor(n):
+    return ('int main() {\n  int a = getint();\n  if (\n'
+            + chain('||', lambda i: f'a == {i}', n)
+            + ')\n    return 1;\n  return 0;\n}\n')
+
+
+def gen_block(n):
+    out = ['int main() {', '  int v = 0;']
+    for i in range(n):
+        out.append('  ' * (i % 32) + f'{{ int v{i % 8} = v + {i}; v = v + v{i % 8};')
+    out.append('}' * n)
+    out.append('  return v;\n}')
+    return '\n'.join(out) + '\n'
+
+
+def gen_while(n):
+    out = ['int main() {', '  int i = 0;']
+    for k in range(n):
+        out.append('  ' * (k % 32) + 'while (i < 10) { i = i + 1;')
+    out.append('}' * n)
+    out.append('  return i;\n}')
+    return '\n'.join(out) + '\n'
+
+
+def gen_funcs(n):
+    out = ['int f0(int x) {\n  return x;\n}']
+    for i in range(1, n):
+        out.append(f'int f{i}(int x) {{\n  int y = x + {i % 7};\n  if (y > 100) y = 0;\n  return f{i - 1}(y);\n}}')
+    out.append(f'int main() {{\n  putint(f{n - 1}(1));\n  return 0;\n}}')
+    return '\n'.join(out) + '\n'
+
+
+def gen_globals(n):
+    out = [f'int g{i} = {i % 100};' for i in range(n)]
+    out.append('int main() {\n  int s = 0;')
+    out += [f'  s = s + g{i};' for i in range(n)]
+    out.append('  return s;\n}')
+    return '\n'.join(out) + '\n'
+
+
+def gen_params(n):
+    params = ', '.join(f'int p{i}' for i in range(n))
+    body = chain('+', lambda i: f'p{i}', n)
+    args = ', '.join(str(i % 10) for i in range(n))
+    return (f'int f({params}) {{\n  return\n{body};\n}}\n'
+            f'int main() {{\n  return f({args});\n}}\n')
+
+
+SHAPES = {
+    'add': gen_add,
+    'lor': gen_lor,
+    'block': gen_block,
+    'while': gen_while,
+    'funcs': gen_funcs,
+    'globals': gen_globals,
+    'params': gen_params,
+}
+
+
+def generate(shape, n):
+    return SHAPES[shape](n)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3 or sys.argv[1] not in SHAPES:
+        sys.exit(f'usage: {sys.argv[0]} <{"|".join(SHAPES)}> <n>')
+    sys.stdout.write(generate(sys.argv[1], int(sys.argv[2])))
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+# the fast lexer must return exactly the tokens of the flex scanner (sysy.l)
+#   lexercheck.py <compiler>
+# every case is compiled to koopa with and without -flex, the exit status,
+# the output and the messages on stderr must be the same. Besides the
+# shapes of gensysy.py the cases go after the edges of the fast scanner:
+# the ends of comments and numbers, bytes flex takes one at a time, and
+# tokens longer than and across the 16 / 32 byte blocks it scans
+
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gensysy
+
+SIZES = {'add': 64, 'lor': 64, 'block': 40, 'while': 40, 'funcs': 20, 'globals': 40, 'params': 40}
+
+MAIN = 'int main() {{\n  {}\n}}\n'
+
+
+def edge_cases():
+    """(name, source bytes) of the hand written cases"""
+    cases = [
+        ('line comment at eof', 'int main() { return 1; } // no newline'),
+        ('line comment at eof, crlf', 'int main() {\r\n  return 1; // x\r\n}\r\n// y'),
+        ('empty line comment at eof', 'int main() { return 1; } //'),
+        ('unterminated block comment', 'int main() { return 1; } /* open'),
+        ('unterminated block comment, star', 'int main() { return 1; } /* open *'),
+        ('block comment /*/', 'int main() { return 4 /*/ 2 */; }'),
+        ('block comment /**/', 'int main() { return 4 /**/ / 2; }'),
+        ('block comment /***/', 'int main() { return 4 /***/ / 2; }'),
+        ('block comment stars', 'int main() { return 4 /* ** * / **/ / 2; }'),
+        ('block comment at eof', 'int main() { return 1; } /* x */'),
+        ('slash star in line comment', 'int main() { return 1; // /* \n}'),
+        ('0x then non hex', MAIN.format('return 0xg;')),
+        ('0x then semicolon', MAIN.format('return 0x;')),
+        ('0x at eof', 'int main() { return 0x'),
+        ('hex upper and lower', MAIN.format('return 0XfF + 0xAb;')),
+        ('09', MAIN.format('return 09;')),
+        ('08 then digits', MAIN.format('return 0812;')),
+        ('octal', MAIN.format('return 0777 + 00 + 0;')),
+        ('INT_MAX', MAIN.format('return 2147483647;')),
+        ('INT_MAX + 1', MAIN.format('return 2147483648;')),
+        ('above INT_MAX', MAIN.format('return 4294967297 + 0x1ffffffff + 077777777777;')),
+        ('LONG_MAX', MAIN.format('return 9223372036854775807;')),
+        ('above LONG_MAX', MAIN.format('return 9223372036854775808 + 99999999999999999999999;')),
+        ('hex above LONG_MAX', MAIN.format('return 0xffffffffffffffffff;')),
+        ('digits then ident', MAIN.format('int a = 1; return 12a;')),
+        ('number at eof', 'int main() { return 12'),
+        ('ident at eof', 'int main() { return abc'),
+        ('operators', MAIN.format('int a = 1; return a<=a>=a==a!=a<a>a&&a||!a%a*a/a-+a;')),
+        ('lone & and |', MAIN.format('int a = 1; return a & a | a;')),
+        ('stray chars', MAIN.format('return 1 @ 2 # $ ` ~ \\ ? \' ";')),
+        ('keywords as prefixes', MAIN.format('int int_ = 1, ifx = 2, whilex = 3, returnx = 4; return int_ + ifx + whilex + returnx;')),
+        ('keywords', 'const int c = 1;\nvoid f() { return; }\nint main() { int i = 0; while (i < c) { if (i) break; else continue; } return 0; }\n'),
+        ('tabs, cr, vt and ff', 'int\tmain()\r\n{\v return\f 1; }'),
+        ('nul byte', 'int main() { return 1; }\0 x'),
+        ('empty', ''),
+        ('only whitespace', ' \n\t\r\n' * 20),
+        ('only a comment', '/* x */ // y'),
+    ]
+    cases = [(name, src.encode()) for name, src in cases]
+
+    # bytes flex matches one at a time with "."
+    utf8 = 'é'.encode()
+    cases += [
+        ('non-ascii in comments', b'int main() { return 1; // \xc3\xa9\n/* \xe2\x82\xac \xff */ }'),
+        ('non-ascii after code', b'int main() { return 1; } ' + utf8),
+        ('non-ascii in ident', b'int main() { int a' + utf8 + b' = 1; return 0; }'),
+        ('high byte', b'int main() { return 1; }\xff'),
+        ('del byte', b'int main() { return 1; }\x7f'),
+    ]
+
+    # tokens against the 16 / 32 byte blocks of the fast scanner, at every
+    # offset: the code before the token is padded by one byte per case
+    long_ident = 'a' * 40 + '_Z9'
+    blocks = []
+    for pad in range(34):
+        lead = ' ' * pad
+        blocks += [
+            (f'long ident, pad {pad}', MAIN.format(f'{lead}int {long_ident} = 1; return {long_ident};')),
+            (f'long number, pad {pad}', MAIN.format(f'{lead}return {"0" * 40}17 + {"1" * 9} + 0x{"0" * 36}ff;')),
+            (f'long comment, pad {pad}', MAIN.format(f'{lead}/* {"*" * 20} {"x/" * 20} */ return 1; // {"y" * 40}')),
+            (f'long whitespace, pad {pad}', MAIN.format(f'{lead}return{" " * 33}\t{chr(10) * 33}1;')),
+            (f'ident at eof, pad {pad}', f'{lead}int main() {{ return 1; }} {long_ident}'),
+            (f'comment at eof, pad {pad}', f'{lead}int main() {{ return 1; }} // {"z" * pad}'),
+        ]
+    for n in (15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 100):
+        ident = 'v' + 'x' * (n - 1)
+        blocks.append((f'ident of {n} bytes', MAIN.format(f'int {ident} = {"9" * (n % 10 + 1)}; return {ident};')))
+    for n in (31, 32, 33, 63, 64, 65):
+        code = 'int main(){return 1;}//'
+        blocks.append((f'file of {n} bytes', code + 'c' * (n - len(code))))
+    cases += [(name, src.encode()) for name, src in blocks]
+    return cases
+
+
+def compile_once(compiler, src, out, flex):
+    """(status, output or None, stderr) of one koopa compile"""
+    if os.path.exists(out):
+        os.remove(out)
+    cmd = [compiler, '-koopa', src, '-o', out] + (['-flex'] if flex else [])
+    proc = subprocess.run(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, timeout=60)
+    output = None
+    if os.path.exists(out):
+        with open(out, 'rb') as f:
+            output = f.read()
+    return proc.returncode, output, proc.stderr
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(f'usage: {sys.argv[0]} <compiler>', file=sys.stderr)
+        return 2
+    cases = [(f'gensysy {shape} {n}', gensysy.generate(shape, n).encode()) for shape, n in SIZES.items()]
+    cases += edge_cases()
+
+    failed = []
+    with tempfile.TemporaryDirectory() as tmp:
+        src, out = os.path.join(tmp, 'lex.c'), os.path.join(tmp, 'lex.koopa')
+        for name, source in cases:
+            with open(src, 'wb') as f:
+                f.write(source)
+            fast = compile_once(sys.argv[1], src, out, False)
+            flex = compile_once(sys.argv[1], src, out, True)
+            if fast != flex:
+                what = [part for part, a, b in zip(('status', 'output', 'stderr'), fast, flex) if a != b]
+                failed.append(f'{name}: {", ".join(what)} differ '
+                              f'(status {fast[0]} without -flex, {flex[0]} with it)')
+
+    print(f'{len(cases)} cases, {len(failed)} differ')
+    for failure in failed:
+        print('  ' + failure)
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
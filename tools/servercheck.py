@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# regression check of the compile server (compiler -server <socket>)
+#   servercheck.py <compiler>
+# sources the compiler rejects (syntax and semantic errors, an unknown
+# mode) must each get an error response, and the server must go on
+# answering: a good source is compiled after every one of them
+
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+GOOD = 'int main() { int x = 1; return x + 1; }\n'
+BAD = [
+    ('-riscv', 'int main() { return 1 }\n', 'syntax error'),
+    ('-riscv', 'int main() { return y; }\n', 'undefined variable'),
+    ('-obj', 'int main() { return f(1); }\n', 'undefined function'),
+    ('-koopa', 'int main() { const int c = 1; c = 2; return c; }\n', 'assignment to constant'),
+    ('-riscv', 'int main() { int a; int a; return 0; }\n', 'redefinition'),
+    ('-riscv', 'int main() { break; return 0; }\n', 'break outside of a loop'),
+    ('-riscv', 'void g() {} int main() { return g(); }\n', 'void value'),
+    ('-asm', GOOD, 'unknown mode'),
+]
+
+
+def request(path, mode, src):
+    """one request, (status, body) or None if the server is gone"""
+    data = src.encode()
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+            sock.connect(path)
+            sock.sendall(f'{mode} {len(data)}\n'.encode() + data)
+            reply = b''
+            while True:
+                chunk = sock.recv(65536)
+                if not chunk:
+                    break
+                reply += chunk
+    except OSError:
+        return None
+    header, _, body = reply.partition(b'\n')
+    fields = header.split()
+    if len(fields) != 2 or len(body) != int(fields[1]):
+        return None
+    return int(fields[0]), body
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(f'usage: {sys.argv[0]} <compiler>', file=sys.stderr)
+        return 2
+    failed = []
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'server.sock')
+        server = subprocess.Popen([sys.argv[1], '-server', path], stderr=subprocess.DEVNULL)
+        try:
+            deadline = time.time() + 10
+            while not os.path.exists(path) and time.time() < deadline:
+                time.sleep(0.01)
+
+            def check(name, mode, src, want_ok):
+                reply = request(path, mode, src)
+                if reply is None:
+                    failed.append(f'{name}: no response')
+                elif (reply[0] == 0) != want_ok:
+                    failed.append(f'{name}: status {reply[0]}')
+                print(f'{name:24} {"no response" if reply is None else "status " + str(reply[0])}')
+
+            check('good', '-riscv', GOOD, True)
+            for mode, src, name in BAD:
+                check(name, mode, src, False)
+                check('  good after it', '-riscv', GOOD, True)
+            if server.poll() is not None:
+                failed.append(f'server exited with {server.returncode}')
+        finally:
+            server.kill()
+            server.wait()
+
+    if failed:
+        print('\nfailed:')
+        for failure in failed:
+            print('  ' + failure)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())